@@ -70,9 +70,17 @@ endif()
 # google tests
 include(FetchGtest)
 
+# tests named *Benchmark only report timings, they are run apart
 add_custom_target(tests-radio
-  COMMAND ${CMAKE_CURRENT_BINARY_DIR}/gtests-radio
+  COMMAND ${CMAKE_CURRENT_BINARY_DIR}/gtests-radio --gtest_filter=-*Benchmark*
   DEPENDS gtests-radio
+  VERBATIM
+  )
+
+add_custom_target(benchmarks-radio
+  COMMAND ${CMAKE_CURRENT_BINARY_DIR}/gtests-radio --gtest_filter=*Benchmark*
+  DEPENDS gtests-radio
+  VERBATIM
   )
 
 if(Qt5Core_FOUND AND NOT DISABLE_COMPANION)
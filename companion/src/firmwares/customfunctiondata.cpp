@@ -144,7 +144,10 @@ QString CustomFunctionData::paramToString(const ModelData * model) const
     return QString("%1").arg(param);
   }
   else if (func == FuncLogs) {
-    return QString("%1").arg(param / 10.0) + tr("s");
+    QString result = QString("%1").arg(param / 10.0) + tr("s");
+    if (repeatParam > 0)
+      result += " / " + QString("%1").arg(repeatParam) + tr("Hz");
+    return result;
   }
   else if (func == FuncPlaySound) {
     return playSoundToString(param);
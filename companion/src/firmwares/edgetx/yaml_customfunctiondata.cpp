@@ -244,6 +244,9 @@ Node convert<CustomFunctionData>::encode(const CustomFunctionData& rhs)
     } else {
       def += std::to_string(rhs.repeatParam);
     }
+  } else if (rhs.func == FuncLogs && rhs.repeatParam > 0) {
+    // sticks and channels sampling rate (Hz)
+    def += "," + std::to_string(rhs.repeatParam);
   }
 
   if (!def.empty()) {
@@ -403,6 +406,11 @@ bool convert<CustomFunctionData>::decode(const Node& node,
         rhs.repeatParam = std::stoi(repeat);
       } catch(...) {}
     }
+  } else if (rhs.func == FuncLogs) {
+    // optional sticks and channels sampling rate (Hz)
+    int rate = 0;
+    def >> rate;
+    rhs.repeatParam = rate;
   }
 
   return true;
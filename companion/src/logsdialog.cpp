@@ -23,6 +23,9 @@
 #include "appdata.h"
 #include "ui_logsdialog.h"
 #include "helpers.h"
+
+#include <QtEndian>
+
 #if defined _MSC_VER || !defined __GNUC__
 #include <windows.h>
 #else
@@ -663,12 +666,202 @@ void LogsDialog::saveSession()
   }
 }
 
+// see radio/src/logs_binary.h for the file layout
+#define LOGS_BINARY_MAGIC      "ETXL"
+#define LOGS_BINARY_VERSION    2
+#define LOGS_BINARY_FLAG_RTC   0x01
+
+enum LogColumnType {
+  LOG_COLUMN_INT8,
+  LOG_COLUMN_INT16,
+  LOG_COLUMN_INT32,
+  LOG_COLUMN_GPS,
+  LOG_COLUMN_DATETIME,
+  LOG_COLUMN_TEXT,
+  LOG_COLUMN_BITS64,
+};
+
+#define LOG_COLUMN_TEXT_LENGTH 16
+
+static QString formatDecimal(qint64 value, int precision)
+{
+  if (precision == 0)
+    return QString::number(value);
+
+  qint64 divisor = 1;
+  for (int i = 0; i < precision; i++)
+    divisor *= 10;
+
+  qint64 absValue = qAbs(value);
+  return QString("%1%2.%3")
+      .arg(value < 0 ? "-" : "")
+      .arg(absValue / divisor)
+      .arg(absValue % divisor, precision, 10, QChar('0'));
+}
+
+static int logColumnSize(uint8_t type)
+{
+  switch (type) {
+    case LOG_COLUMN_INT8:
+      return 1;
+    case LOG_COLUMN_INT16:
+      return 2;
+    case LOG_COLUMN_INT32:
+      return 4;
+    case LOG_COLUMN_GPS:
+    case LOG_COLUMN_DATETIME:
+    case LOG_COLUMN_BITS64:
+      return 8;
+    case LOG_COLUMN_TEXT:
+      return LOG_COLUMN_TEXT_LENGTH;
+    default:
+      return 0;
+  }
+}
+
+static QString formatColumn(uint8_t type, uint8_t precision, const uchar * value)
+{
+  switch (type) {
+    case LOG_COLUMN_INT8:
+      return formatDecimal((int8_t)value[0], precision);
+    case LOG_COLUMN_INT16:
+      return formatDecimal(qFromLittleEndian<qint16>(value), precision);
+    case LOG_COLUMN_INT32:
+      return formatDecimal(qFromLittleEndian<qint32>(value), precision);
+    case LOG_COLUMN_GPS: {
+      qint32 latitude = qFromLittleEndian<qint32>(value);
+      qint32 longitude = qFromLittleEndian<qint32>(value + 4);
+      if (latitude && longitude)
+        return formatDecimal(latitude, 6) + " " + formatDecimal(longitude, 6);
+      return "";
+    }
+    case LOG_COLUMN_DATETIME:
+      return QString("%1-%2-%3 %4:%5:%6")
+                 .arg(qFromLittleEndian<quint16>(value), 4, 10, QChar('0'))
+                 .arg(value[2], 2, 10, QChar('0'))
+                 .arg(value[3], 2, 10, QChar('0'))
+                 .arg(value[4], 2, 10, QChar('0'))
+                 .arg(value[5], 2, 10, QChar('0'))
+                 .arg(value[6], 2, 10, QChar('0'));
+    case LOG_COLUMN_TEXT:
+      return "\"" + QString::fromUtf8((const char *)value,
+                                      qstrnlen((const char *)value, LOG_COLUMN_TEXT_LENGTH)) + "\"";
+    case LOG_COLUMN_BITS64:
+      return "0x" + QString("%1").arg(qFromLittleEndian<quint64>(value), 16, 16, QChar('0')).toUpper();
+    default:
+      return QString();
+  }
+}
+
+bool LogsDialog::binaryFileParse(QFile & file)
+{
+  const QByteArray data = file.readAll();
+  const uchar * bytes = (const uchar *)data.constData();
+  const int fileHeaderSize = 16;
+
+  if (data.size() < fileHeaderSize || !data.startsWith(LOGS_BINARY_MAGIC) ||
+      bytes[4] > LOGS_BINARY_VERSION) {
+    return false;
+  }
+
+  // version 1 has a single group and no group byte
+  uint8_t version = bytes[4];
+  int columnHeaderSize = (version >= 2 ? 4 : 3);
+  uint8_t flags = bytes[5];
+  int columnCount = qFromLittleEndian<quint16>(bytes + 6);
+  int groupCount = (version >= 2 ? qFromLittleEndian<quint16>(bytes + 8) : 1);
+  int headerSize = qFromLittleEndian<quint16>(bytes + 10);
+  quint32 startTime = qFromLittleEndian<quint32>(bytes + 12);
+
+  struct Column {
+    uint8_t type;
+    uint8_t precision;
+    uint8_t group;
+  };
+  QVector<Column> columns;
+  QVector<int> recordSizes(groupCount, 0);
+
+  QStringList header;
+  header << "Date" << "Time";
+
+  int offset = fileHeaderSize;
+  for (int i = 0; i < columnCount; i++) {
+    if (offset + columnHeaderSize > headerSize || headerSize > data.size())
+      return false;
+    Column column = { bytes[offset], bytes[offset + 1], 0 };
+    if (version >= 2)
+      column.group = bytes[offset + 2];
+    int nameLength = bytes[offset + columnHeaderSize - 1];
+    offset += columnHeaderSize;
+    if (column.group >= groupCount || logColumnSize(column.type) == 0)
+      return false;
+    recordSizes[column.group] += logColumnSize(column.type);
+    header << QString::fromUtf8(data.constData() + offset, nameLength);
+    offset += nameLength;
+    columns.append(column);
+  }
+  csvlog.append(header);
+
+  QDateTime start = QDateTime::fromSecsSinceEpoch(
+      (flags & LOGS_BINARY_FLAG_RTC) ? startTime : 0, Qt::UTC);
+
+  // columns of the other groups keep their last value
+  QStringList values;
+  for (int i = 0; i < columnCount; i++)
+    values << "";
+
+  offset = headerSize;
+  while (offset < data.size()) {
+    int group = 0;
+    if (version >= 2)
+      group = bytes[offset++];
+    if (group >= groupCount || offset + 4 + recordSizes[group] > data.size())
+      break;
+
+    const uchar * record = bytes + offset;
+    QDateTime time = start.addMSecs(qFromLittleEndian<quint32>(record));
+    record += 4;
+    offset += 4 + recordSizes[group];
+
+    for (int i = 0; i < columnCount; i++) {
+      const Column & column = columns[i];
+      if (column.group == group) {
+        values[i] = formatColumn(column.type, column.precision, record);
+        record += logColumnSize(column.type);
+      }
+    }
+
+    QStringList row;
+    row << time.toString("yyyy-MM-dd") << time.toString("HH:mm:ss.zzz");
+    row << values;
+    csvlog.append(row);
+  }
+
+  return true;
+}
+
 bool LogsDialog::cvsFileParse()
 {
   QFile file(ui->FileName_LE->text());
   int errors=0;
   int lines=-1;
 
+  if (file.open(QIODevice::ReadOnly) && file.peek(4) == LOGS_BINARY_MAGIC) {
+    csvlog.clear();
+    logFilename = QFileInfo(file.fileName()).baseName();
+    bool ok = binaryFileParse(file);
+    file.close();
+    if (!ok || csvlog.count() <= 1) {
+      csvlog.clear();
+      return false;
+    }
+    plotLock = true;
+    setFlightSessions();
+    plotLock = false;
+    return true;
+  }
+  file.close();
+
   if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) { // reading HEX TEXT file
     return false;
   }
@@ -102,6 +102,7 @@ private:
   QCPItemStraightLine * cursorLine;
 
   bool cvsFileParse();
+  bool binaryFileParse(QFile & file);
   QList<QStringList> filterGePoints(const QList<QStringList> & input);
   void exportToGoogleEarth();
   QDateTime getRecordTimeStamp(int index);
@@ -30,10 +30,12 @@
 #endif
 
 #include "model_audio.h"
+#include "audio_kernels.h"
+#include "timers_driver.h"
 
 extern RTOS_MUTEX_HANDLE audioMutex;
 
-const int16_t sineValues[] =
+const int16_t sineValues[1 << TONE_TABLE_BITS] =
 {
     0, 196, 392, 588, 784, 980, 1175, 1370, 1564, 1758,
     1951, 2143, 2335, 2525, 2715, 2904, 3091, 3278, 3463, 3647,
@@ -276,6 +278,85 @@ void getSystemAudioFile(char * filename, int index)
   strcat(str, SOUNDS_EXT);
 }
 
+// Case insensitive FNV-1a hash of audio file names
+static uint32_t audioHashUpdate(uint32_t hash, const char * str, size_t len)
+{
+  for (size_t i = 0; i < len && str[i]; i++) {
+    char c = str[i];
+    if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+    hash = (hash ^ (uint8_t)c) * 16777619u;
+  }
+  return hash;
+}
+
+#define AUDIO_HASH_INIT  2166136261u
+
+static uint32_t audioFilenameHash(const char * filename)
+{
+  return audioHashUpdate(AUDIO_HASH_INIT, filename, AUDIO_FILENAME_MAXLEN);
+}
+
+// Open addressing table of the system sound file names, index + 1 of
+// each name in audioFilenames, 0 for a free slot
+#define SYSTEM_AUDIO_FILES_SLOTS  128
+static_assert(SYSTEM_AUDIO_FILES_SLOTS >= 2 * AU_SPECIAL_SOUND_FIRST, "System audio files table too small");
+static uint8_t systemAudioFilesTable[SYSTEM_AUDIO_FILES_SLOTS];
+static bool systemAudioFilesTableReady;
+
+static uint32_t systemAudioFileHash(int index)
+{
+  uint32_t hash = audioHashUpdate(AUDIO_HASH_INIT, audioFilenames[index], AUDIO_FILENAME_MAXLEN);
+  return audioHashUpdate(hash, SOUNDS_EXT, sizeof(SOUNDS_EXT));
+}
+
+static int findSystemAudioFile(const char * filename)
+{
+  if (!systemAudioFilesTableReady) {
+    for (int i = 0; i < AU_SPECIAL_SOUND_FIRST; i++) {
+      uint32_t slot = systemAudioFileHash(i);
+      while (systemAudioFilesTable[slot % SYSTEM_AUDIO_FILES_SLOTS]) slot++;
+      systemAudioFilesTable[slot % SYSTEM_AUDIO_FILES_SLOTS] = i + 1;
+    }
+    systemAudioFilesTableReady = true;
+  }
+
+  for (uint32_t slot = audioFilenameHash(filename);; slot++) {
+    uint8_t entry = systemAudioFilesTable[slot % SYSTEM_AUDIO_FILES_SLOTS];
+    if (!entry) return -1;
+    const char * name = audioFilenames[entry - 1];
+    size_t len = strlen(name);
+    if (!strncasecmp(filename, name, len) && !strcasecmp(filename + len, SOUNDS_EXT)) {
+      return entry - 1;
+    }
+  }
+}
+
+// The directories are scanned again only when the SD card has been
+// unmounted (FAT does not update the timestamps of the directories when
+// their files change)
+static const LanguagePack * systemAudioFilesPack;
+
+#define MODEL_AUDIO_FILES_CACHE_SIZE  4
+
+struct ModelAudioFiles {
+  uint32_t key;  // the directory and the names its files are matched against
+  BitField<(MAX_FLIGHT_MODES * 2/*on, off*/)> flightModes;
+  BitField<MAX_SWITCH_POSITIONS> switches;
+  BitField<(MAX_LOGICAL_SWITCHES * 2/*on, off*/)> logicalSwitches;
+};
+
+static ModelAudioFiles modelAudioFilesCache[MODEL_AUDIO_FILES_CACHE_SIZE];
+static uint8_t modelAudioFilesCacheNext;
+
+void resetAudioFilesCache()
+{
+  sdAvailableSystemAudioFiles.reset();
+  systemAudioFilesPack = nullptr;
+  for (auto & entry : modelAudioFilesCache) {
+    entry.key = 0;
+  }
+}
+
 void referenceSystemAudioFiles()
 {
   static_assert(sizeof(audioFilenames)==AU_SPECIAL_SOUND_FIRST*sizeof(char *), "Invalid audioFilenames size");
@@ -283,6 +364,9 @@ void referenceSystemAudioFiles()
   FILINFO fno;
   DIR dir;
 
+  if (systemAudioFilesPack == currentLanguagePack)
+    return;
+
   sdAvailableSystemAudioFiles.reset();
 
   char * filename = strAppendSystemAudioPath(path);
@@ -298,18 +382,34 @@ void referenceSystemAudioFiles()
       // Eliminates directories / non wav files
       if (len < 5 || strcasecmp(fno.fname+len-4, SOUNDS_EXT) || (fno.fattrib & AM_DIR)) continue;
 
-      for (int i=0; i<AU_SPECIAL_SOUND_FIRST; i++) {
-        getSystemAudioFile(path, i);
-        if (!strcasecmp(filename, fno.fname)) {
-          sdAvailableSystemAudioFiles.setBit(i);
-          break;
-        }
+      int index = findSystemAudioFile(fno.fname);
+      if (index >= 0) {
+        sdAvailableSystemAudioFiles.setBit(index);
       }
     }
     f_closedir(&dir);
+    systemAudioFilesPack = currentLanguagePack;
   }
 }
 
+static uint32_t modelAudioFilesKey(const char * path)
+{
+  uint32_t hash = audioHashUpdate(AUDIO_HASH_INIT, path, AUDIO_FILENAME_MAXLEN);
+  for (int i = 0; i < MAX_FLIGHT_MODES; i++) {
+    hash = audioHashUpdate(hash, g_model.flightModeData[i].name, LEN_FLIGHT_MODE_NAME);
+    hash = audioHashUpdate(hash, "/", 1);
+  }
+  for (int i = 0; i < switchGetMaxSwitches(); i++) {
+    const char * name = switchGetName(i);
+    if (name) hash = audioHashUpdate(hash, name, AUDIO_FILENAME_MAXLEN);
+    hash = audioHashUpdate(hash, "/", 1);
+  }
+  for (int i = 0; i < MAX_POTS; i++) {
+    hash = audioHashUpdate(hash, IS_POT_MULTIPOS(i) ? "m" : "p", 1);
+  }
+  return hash ? hash : 1;
+}
+
 void referenceModelAudioFiles()
 {
   DIR dir;
@@ -322,6 +422,16 @@ void referenceModelAudioFiles()
 
   getModelAudioPath(path, false);
 
+  uint32_t key = modelAudioFilesKey(path);
+  for (const auto & entry : modelAudioFilesCache) {
+    if (entry.key == key) {
+      sdAvailableFlightmodeAudioFiles = entry.flightModes;
+      sdAvailableSwitchAudioFiles = entry.switches;
+      sdAvailableLogicalSwitchAudioFiles = entry.logicalSwitches;
+      return;
+    }
+  }
+
   FRESULT res = f_opendir(&dir, path); /* Open the directory */
   if (res == FR_OK) {
     for (;;) {
@@ -359,6 +469,17 @@ void referenceModelAudioFiles()
     }
     f_closedir(&dir);
   }
+  else if (res != FR_NO_PATH && res != FR_NO_FILE) {
+    return;
+  }
+
+  // also when the directory does not exist, which is the most common case
+  auto & entry = modelAudioFilesCache[modelAudioFilesCacheNext];
+  modelAudioFilesCacheNext = (modelAudioFilesCacheNext + 1) % MODEL_AUDIO_FILES_CACHE_SIZE;
+  entry.key = key;
+  entry.flightModes = sdAvailableFlightmodeAudioFiles;
+  entry.switches = sdAvailableSwitchAudioFiles;
+  entry.logicalSwitches = sdAvailableLogicalSwitchAudioFiles;
 }
 
 bool isAudioFileReferenced(uint32_t i, char * filename)
@@ -425,6 +546,18 @@ void playModelName()
 
 AudioQueue audioQueue __DMA;      // to place it in the RAM section on Horus, to have file buffers in RAM for DMA access
 AudioBuffer audioBuffers[AUDIO_BUFFER_COUNT] __DMA;
+AudioStats audioStats;
+
+// bin 0 below base, then one bin per power of 2, the last one unbounded
+static void audioStatsRecord(uint32_t * bins, uint32_t value, uint32_t base)
+{
+  unsigned bin = 0;
+  while (value >= base && bin < AUDIO_STATS_BINS - 1) {
+    base <<= 1;
+    bin++;
+  }
+  bins[bin]++;
+}
 
 AudioQueue::AudioQueue()
   : buffersFifo(),
@@ -433,11 +566,15 @@ AudioQueue::AudioQueue()
   backgroundContext(),
   priorityContext(),
   varioContext(),
-  fragmentsFifo()
+  fragmentsFifo(),
+  prefetchedContext(),
+  prefetchedFragment(nullptr),
+  streaming(false)
 {
 }
 
 #define CODEC_ID_PCM_S16LE  1
+#define CODEC_ID_IMA_ADPCM  0x11
 
 #if !defined(SIMU)
 void audioTask(void * pdata)
@@ -463,90 +600,552 @@ void audioTask(void * pdata)
 }
 #endif
 
-inline void mixSample(audio_data_t * result, int sample, unsigned int fade)
+// the samples of a context are built in a block, then mixed at once
+inline void mixSamples(audio_data_t * data, const int16_t * samples, uint32_t count, unsigned int fade)
 {
-  *result = limit(AUDIO_DATA_MIN, *result + ((sample >> fade) >> (16-AUDIO_BITS_PER_SAMPLE)), AUDIO_DATA_MAX);
+  audioMix(data, samples, count, fade + (16-AUDIO_BITS_PER_SAMPLE));
 }
 
+// sample rates which are not a divider of AUDIO_SAMPLE_RATE are interpolated
+#define WAV_MIN_FREQ            8000
+#define WAV_MAX_FREQ            48000
+#define WAV_BUFFER_SAMPLES      (2 + AUDIO_BUFFER_SIZE * WAV_MAX_FREQ / AUDIO_SAMPLE_RATE)
+#define WAV_INTERPOLATE_CHUNK   32
+
+// also the scratch buffer where the tones are generated
+uint8_t wavBuffer[WAV_BUFFER_SAMPLES*2] __DMA;
+
 #if defined(SDCARD)
 
 #define RIFF_CHUNK_SIZE 12
-uint8_t wavBuffer[AUDIO_BUFFER_SIZE*2] __DMA;
 
-int WavContext::mixBuffer(AudioBuffer *buffer, int volume, unsigned int fade)
-{
-  FRESULT result = FR_OK;
-  UINT read = 0;
+#define WAV_ADPCM_CHUNK     32
+
+#if defined(AUDIO_PHRASE_CACHE)
+// Samples of the last number phrases, recorded while their files are
+// played, the least recently used ones being freed when the memory is
+// needed. Only used by the audio task
+class AudioPhraseCache {
+  public:
+    struct Entry {
+      uint32_t key;
+      uint32_t lastUse;
+      uint32_t freq;
+      uint32_t count;
+      int16_t * samples;
+    };
+
+    // the cache is emptied by start(), when the normal context, the only
+    // one playing cached samples, no longer plays them
+    void requestReset()
+    {
+      resetRequested = true;
+    }
 
-  if(fragment.fragmentVolume != USE_SETTINGS_VOLUME)
-    volume = fragment.fragmentVolume;
+    bool isCached(const AudioFragment & fragment)
+    {
+      return !resetRequested && isHead(fragment) && find(fragment.phrase);
+    }
 
-  if (fragment.file[1]) {
-    result = f_open(&state.file, fragment.file, FA_OPEN_EXISTING | FA_READ);
-    fragment.file[1] = 0;
-    if (result == FR_OK) {
-      result = f_read(&state.file, wavBuffer, RIFF_CHUNK_SIZE+8, &read);
-      if (result == FR_OK && read == RIFF_CHUNK_SIZE+8 && !memcmp(wavBuffer, "RIFF", 4) && !memcmp(wavBuffer+8, "WAVEfmt ", 8)) {
-        uint32_t size = *((uint32_t *)(wavBuffer+16));
-        result = (size < 256 ? f_read(&state.file, wavBuffer, size+8, &read) : FR_DENIED);
-        if (result == FR_OK && read == size+8) {
-          state.codec = ((uint16_t *)wavBuffer)[0];
-          state.freq = ((uint16_t *)wavBuffer)[2];
-          uint32_t *wavSamplesPtr = (uint32_t *)(wavBuffer + size);
-          uint32_t size = wavSamplesPtr[1];
-          if (state.freq != 0 && state.freq * (AUDIO_SAMPLE_RATE / state.freq) == AUDIO_SAMPLE_RATE) {
-            state.resampleRatio = (AUDIO_SAMPLE_RATE / state.freq);
-            state.readSize = (state.codec == CODEC_ID_PCM_S16LE ? 2*AUDIO_BUFFER_SIZE : AUDIO_BUFFER_SIZE) / state.resampleRatio;
-          }
-          else {
-            result = FR_DENIED;
-          }
-          while (result == FR_OK && memcmp(wavSamplesPtr, "data", 4) != 0) {
-            result = f_lseek(&state.file, f_tell(&state.file)+size);
-            if (result == FR_OK) {
-              result = f_read(&state.file, wavBuffer, 8, &read);
-              if (read != 8) result = FR_DENIED;
-              wavSamplesPtr = (uint32_t *)wavBuffer;
-              size = wavSamplesPtr[1];
-            }
+    // the cached samples of the phrase starting with the fragment, when
+    // they are not yet cached the phrase is recorded. Called when the
+    // normal context is given a new fragment
+    const Entry * start(const AudioFragment & fragment)
+    {
+      if (resetRequested) {
+        reset();
+      }
+      if (!isHead(fragment))
+        return nullptr;
+      const Entry * entry = find(fragment.phrase);
+      if (!entry) {
+        abort();
+        recording.key = fragment.phrase;
+        recording.length = fragment.phraseLength;
+      }
+      return entry;
+    }
+
+    void append(const AudioFragment & fragment, uint32_t freq, const int16_t * samples, uint32_t count)
+    {
+      if (!isRecording(fragment))
+        return;
+
+      if (!recording.samples) {
+        // allocated once the sample rate is known
+        recording.freq = freq;
+        recording.capacity = min<uint32_t>(freq * AUDIO_PHRASE_MAX_DURATION / 1000, AUDIO_PHRASE_CACHE_SIZE / 2 / sizeof(int16_t));
+        if (!reserve(recording.capacity * sizeof(int16_t)) ||
+            !(recording.samples = (int16_t *)malloc(recording.capacity * sizeof(int16_t)))) {
+          abort();
+          return;
+        }
+        used += recording.capacity * sizeof(int16_t);
+      }
+
+      if (freq != recording.freq || recording.count + count > recording.capacity) {
+        abort();
+        return;
+      }
+
+      memcpy(recording.samples + recording.count, samples, count * sizeof(int16_t));
+      recording.count += count;
+    }
+
+    void endFile(const AudioFragment & fragment)
+    {
+      if (isRecording(fragment) && ++recording.next == recording.length) {
+        commit();
+      }
+    }
+
+  private:
+    Entry entries[AUDIO_PHRASE_CACHE_ENTRIES] = {};
+    uint32_t useCounter = 0;
+    uint32_t used = 0;  // bytes, including the recording buffer
+    volatile bool resetRequested = false;
+
+    struct {
+      uint32_t key;
+      uint8_t length;
+      uint8_t next;      // index of the file being recorded
+      uint32_t freq;
+      uint32_t count;
+      uint32_t capacity;
+      int16_t * samples;
+    } recording = {};
+
+    static bool isHead(const AudioFragment & fragment)
+    {
+      return fragment.phraseLength > 0 && fragment.phraseIndex == 0;
+    }
+
+    const Entry * find(uint32_t key)
+    {
+      for (auto & entry : entries) {
+        if (entry.samples && entry.key == key) {
+          entry.lastUse = ++useCounter;
+          return &entry;
+        }
+      }
+      return nullptr;
+    }
+
+    bool isRecording(const AudioFragment & fragment)
+    {
+      if (!recording.key || fragment.phrase != recording.key)
+        return false;
+      if (fragment.phraseIndex != recording.next) {
+        // a file of the phrase could not be played
+        abort();
+        return false;
+      }
+      return true;
+    }
+
+    void abort()
+    {
+      if (recording.samples) {
+        free(recording.samples);
+        used -= recording.capacity * sizeof(int16_t);
+      }
+      recording = {};
+    }
+
+    void commit()
+    {
+      Entry * entry = nullptr;
+      if (recording.count > 0) {
+        for (auto & e : entries) {
+          if (!e.samples) {
+            entry = &e;
+            break;
           }
-          state.size = size;
         }
-        else {
+      }
+      if (!entry) {
+        abort();
+        return;
+      }
+
+      // shrunk in place
+      int16_t * samples = (int16_t *)realloc(recording.samples, recording.count * sizeof(int16_t));
+      if (samples) {
+        recording.samples = samples;
+        used -= (recording.capacity - recording.count) * sizeof(int16_t);
+        recording.capacity = recording.count;
+      }
+
+      entry->key = recording.key;
+      entry->lastUse = ++useCounter;
+      entry->freq = recording.freq;
+      entry->count = recording.count;
+      entry->samples = recording.samples;
+      recording = {};
+    }
+
+    // frees the least recently used phrases until there is room for the
+    // recording and an entry for it
+    bool reserve(uint32_t size)
+    {
+      while (true) {
+        Entry * oldest = nullptr;
+        bool entryFree = false;
+        for (auto & entry : entries) {
+          if (!entry.samples)
+            entryFree = true;
+          else if (!oldest || entry.lastUse < oldest->lastUse)
+            oldest = &entry;
+        }
+        if (entryFree && used + size <= AUDIO_PHRASE_CACHE_SIZE)
+          return true;
+        if (!oldest)
+          return false;
+        freeEntry(*oldest);
+      }
+    }
+
+    void freeEntry(Entry & entry)
+    {
+      free(entry.samples);
+      used -= entry.count * sizeof(int16_t);
+      entry.samples = nullptr;
+    }
+
+    void reset()
+    {
+      resetRequested = false;
+      abort();
+      for (auto & entry : entries) {
+        if (entry.samples) {
+          freeEntry(entry);
+        }
+      }
+    }
+};
+
+static AudioPhraseCache audioPhraseCache;
+#endif
+
+// the sample rates played by repeating each sample
+static bool isWavRateDivider(uint32_t freq)
+{
+  if (freq == 0 || freq * (AUDIO_SAMPLE_RATE / freq) != AUDIO_SAMPLE_RATE)
+    return false;
+#if defined(AUDIO_INTERPOLATE)
+  return freq == AUDIO_SAMPLE_RATE;
+#else
+  return true;
+#endif
+}
+
+static const int16_t imaAdpcmSteps[] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+  50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+  253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+  1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+  3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+  11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+  32767
+};
+
+static const int8_t imaAdpcmIndexes[] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+static int16_t imaAdpcmDecode(int16_t & predictor, uint8_t & index, uint8_t nibble)
+{
+  int32_t step = imaAdpcmSteps[index];
+  int32_t diff = step >> 3;
+  if (nibble & 4) diff += step;
+  if (nibble & 2) diff += step >> 1;
+  if (nibble & 1) diff += step >> 2;
+  predictor = limit<int32_t>(INT16_MIN, predictor + ((nibble & 8) ? -diff : diff), INT16_MAX);
+  index = limit<int>(0, index + imaAdpcmIndexes[nibble & 7], DIM(imaAdpcmSteps) - 1);
+  return predictor;
+}
+
+// Reads up to count samples of the data chunk, the IMA-ADPCM ones (mono,
+// 4 bits per sample after a 4 bytes header in each block) being decoded
+FRESULT WavContext::readSamples(int16_t * samples, uint32_t count, uint32_t * read)
+{
+  UINT bytes = 0;
+
+  if (state.codec == CODEC_ID_PCM_S16LE) {
+#if defined(AUDIO_PHRASE_CACHE)
+    if (state.memory) {
+      *read = min<uint32_t>(count, state.size / 2);
+      memcpy(samples, state.memory, *read * 2);
+      state.memory += *read;
+      state.size -= *read * 2;
+      return FR_OK;
+    }
+#endif
+    FRESULT result = f_read(&state.file, samples, count * 2, &bytes);
+    bytes = min<UINT>(bytes, state.size);
+    state.size -= bytes;
+    *read = bytes / 2;
+    return result;
+  }
+
+  uint32_t n = 0;
+  uint8_t data[WAV_ADPCM_CHUNK];
+  while (n < count) {
+    if (state.nibble) {
+      samples[n++] = imaAdpcmDecode(state.predictor, state.stepIndex, state.nibble & 0x0f);
+      state.nibble = 0;
+      continue;
+    }
+
+    if (state.blockRemaining == 0) {
+      // block header: the first sample and the step index
+      if (state.size < 4)
+        break;
+      FRESULT result = f_read(&state.file, data, 4, &bytes);
+      if (result != FR_OK || bytes != 4) {
+        *read = n;
+        return result;
+      }
+      state.size -= 4;
+      state.predictor = (int16_t)(data[0] | (data[1] << 8));
+      state.stepIndex = min<uint8_t>(data[2], DIM(imaAdpcmSteps) - 1);
+      state.blockRemaining = state.blockAlign - 4;
+      samples[n++] = state.predictor;
+      continue;
+    }
+
+    UINT size = min<uint32_t>(min<uint32_t>(state.blockRemaining, state.size),
+                              min<uint32_t>(WAV_ADPCM_CHUNK, (count - n + 1) / 2));
+    if (size == 0)
+      break;
+    FRESULT result = f_read(&state.file, data, size, &bytes);
+    if (result != FR_OK) {
+      *read = n;
+      return result;
+    }
+    state.size -= bytes;
+    state.blockRemaining -= bytes;
+    for (UINT i = 0; i < bytes; i++) {
+      samples[n++] = imaAdpcmDecode(state.predictor, state.stepIndex, data[i] & 0x0f);
+      if (n < count)
+        samples[n++] = imaAdpcmDecode(state.predictor, state.stepIndex, data[i] >> 4);
+      else
+        state.nibble = 0x10 | (data[i] >> 4);
+    }
+    if (bytes != size)
+      break;
+  }
+
+  *read = n;
+  return FR_OK;
+}
+
+// Linear interpolation of the samples read after the 2 last ones of the
+// previous block, in Q16 steps
+uint32_t WavContext::interpolateBuffer(AudioBuffer * buffer, uint32_t read, unsigned int fade)
+{
+  int16_t * samples = (int16_t *)wavBuffer;
+  samples[0] = state.history[0];
+  samples[1] = state.history[1];
+
+  const uint32_t end = (read + 1) << 16;
+  uint32_t position = state.position;
+  uint32_t count = 0;
+  // read by pairs by the mixing kernel
+  int16_t chunk[WAV_INTERPOLATE_CHUNK] __ALIGNED(4);
+  while (count < AUDIO_BUFFER_SIZE && position < end) {
+    uint32_t n = 0;
+    while (n < WAV_INTERPOLATE_CHUNK && count + n < AUDIO_BUFFER_SIZE && position < end) {
+      const int16_t * s = &samples[position >> 16];
+      chunk[n++] = s[0] + (((s[1] - s[0]) * (int32_t)((position & 0xffff) >> 1)) >> 15);
+      position += state.step;
+    }
+    mixSamples(buffer->data + count, chunk, n, fade);
+    count += n;
+  }
+
+  state.history[0] = samples[read];
+  state.history[1] = samples[read + 1];
+  state.position = position - (read << 16);
+  return count;
+}
+
+// The samples are either repeated or interpolated
+FRESULT WavContext::setSampleRate(uint32_t freq)
+{
+  state.freq = freq;
+  if (isWavRateDivider(freq)) {
+    state.resampleRatio = (AUDIO_SAMPLE_RATE / freq);
+  }
+  else if (freq >= WAV_MIN_FREQ && freq <= WAV_MAX_FREQ) {
+    state.resampleRatio = 0;
+    state.step = (freq << 16) / AUDIO_SAMPLE_RATE;
+    state.position = 2 << 16;
+    state.history[0] = state.history[1] = 0;
+  }
+  else {
+    return FR_DENIED;
+  }
+  return FR_OK;
+}
+
+// Opens the file of the fragment and parses its header, the first data
+// sector is then in the sector buffer of the file
+FRESULT WavContext::openFile()
+{
+  UINT read = 0;
+  FRESULT result = f_open(&state.file, fragment.file, FA_OPEN_EXISTING | FA_READ);
+  fragment.file[1] = 0;
+#if defined(AUDIO_PHRASE_CACHE)
+  state.memory = nullptr;
+#endif
+  if (result == FR_OK) {
+    result = f_read(&state.file, wavBuffer, RIFF_CHUNK_SIZE+8, &read);
+    if (result == FR_OK && read == RIFF_CHUNK_SIZE+8 && !memcmp(wavBuffer, "RIFF", 4) && !memcmp(wavBuffer+8, "WAVEfmt ", 8)) {
+      uint32_t size = *((uint32_t *)(wavBuffer+16));
+      result = (size < 256 ? f_read(&state.file, wavBuffer, size+8, &read) : FR_DENIED);
+      if (result == FR_OK && read == size+8) {
+        state.codec = ((uint16_t *)wavBuffer)[0];
+        state.freq = ((uint16_t *)wavBuffer)[2];
+        state.blockAlign = ((uint16_t *)wavBuffer)[6];
+        state.blockRemaining = 0;
+        state.nibble = 0;
+        uint32_t *wavSamplesPtr = (uint32_t *)(wavBuffer + size);
+        uint32_t size = wavSamplesPtr[1];
+        if (state.codec != CODEC_ID_PCM_S16LE &&
+            (state.codec != CODEC_ID_IMA_ADPCM || ((uint16_t *)wavBuffer)[1] != 1 || state.blockAlign <= 4)) {
           result = FR_DENIED;
         }
+        else {
+          result = setSampleRate(state.freq);
+        }
+        while (result == FR_OK && memcmp(wavSamplesPtr, "data", 4) != 0) {
+          result = f_lseek(&state.file, f_tell(&state.file)+size);
+          if (result == FR_OK) {
+            result = f_read(&state.file, wavBuffer, 8, &read);
+            if (read != 8) result = FR_DENIED;
+            wavSamplesPtr = (uint32_t *)wavBuffer;
+            size = wavSamplesPtr[1];
+          }
+        }
+        state.size = size;
       }
       else {
         result = FR_DENIED;
       }
     }
+    else {
+      result = FR_DENIED;
+    }
+    if (result != FR_OK) {
+      f_close(&state.file);
+    }
+  }
+  return result;
+}
+
+#if defined(AUDIO_PHRASE_CACHE)
+// Plays the cached samples of a phrase instead of the file of the fragment
+void WavContext::setPhrase(const int16_t * samples, uint32_t count, uint32_t freq)
+{
+  fragment.file[1] = 0;
+  fragment.phrase = 0;
+  fragment.phraseLength = 0;
+  state.memory = samples;
+  state.codec = CODEC_ID_PCM_S16LE;
+  state.size = count * sizeof(int16_t);
+  if (setSampleRate(freq) != FR_OK) {
+    clear();
+  }
+}
+#endif
+
+// clear(), the file opened by prefetch() or mixBuffer() being closed
+void WavContext::close()
+{
+  if (fragment.type == FRAGMENT_FILE && !fragment.file[1]
+#if defined(AUDIO_PHRASE_CACHE)
+      && !state.memory
+#endif
+      ) {
+    f_close(&state.file);
+  }
+  clear();
+}
+
+// Opens the file ahead of mixBuffer(), while another fragment plays
+bool WavContext::prefetch()
+{
+  if (fragment.file[1] && openFile() != FR_OK) {
+    clear();
+    return false;
+  }
+  return true;
+}
+
+int WavContext::mixBuffer(AudioBuffer *buffer, int volume, unsigned int fade)
+{
+  FRESULT result = FR_OK;
+
+  if(fragment.fragmentVolume != USE_SETTINGS_VOLUME)
+    volume = fragment.fragmentVolume;
+
+  uint32_t start = timersGetUsTick();
+
+  if (fragment.file[1]) {
+    result = openFile();
   }
 
   if (result == FR_OK) {
-    read = 0;
-    result = f_read(&state.file, wavBuffer, state.readSize, &read);
+    // enough samples for a full buffer, after the history ones when interpolated
+    int16_t * samples = (int16_t *)wavBuffer;
+    uint32_t count;
+    if (state.resampleRatio == 0) {
+      samples += 2;
+      count = (state.position + (AUDIO_BUFFER_SIZE-1) * state.step) >> 16;
+    }
+    else {
+      count = AUDIO_BUFFER_SIZE / state.resampleRatio;
+    }
+
+    uint32_t read = 0;
+    result = readSamples(samples, count, &read);
+
+    uint32_t duration = timersGetUsTick() - start;
+    audioStatsRecord(audioStats.decodeTime, duration, AUDIO_STATS_DECODE_TIME_BASE);
+    audioStats.maxDecodeTime = max<uint32_t>(audioStats.maxDecodeTime, min<uint32_t>(duration, UINT16_MAX));
+
     if (result == FR_OK) {
-      if (read > state.size) {
-        read = state.size;
+#if defined(AUDIO_PHRASE_CACHE)
+      if (fragment.phrase) {
+        audioPhraseCache.append(fragment, state.freq, samples, read);
       }
-      state.size -= read;
-
-      if (read != state.readSize) {
+#endif
+      if (read != count) {
+#if defined(AUDIO_PHRASE_CACHE)
+        if (fragment.phrase) {
+          audioPhraseCache.endFile(fragment);
+        }
+        if (!state.memory)
+#endif
         f_close(&state.file);
         fragment.clear();
       }
 
-      audio_data_t * samples = buffer->data;
-      if (state.codec == CODEC_ID_PCM_S16LE) {
-        read /= 2;
-        for (uint32_t i=0; i<read; i++) {
+      if (state.resampleRatio == 0) {
+        return interpolateBuffer(buffer, read, fade+2-volume);
+      }
+
+      // samples are duplicated in place, from the end
+      count = read * state.resampleRatio;
+      if (state.resampleRatio > 1) {
+        int16_t * dst = samples + count;
+        for (uint32_t i=read; i-- > 0;) {
           for (uint8_t j=0; j<state.resampleRatio; j++) {
-            mixSample(samples++, ((int16_t *)wavBuffer)[i], fade+2-volume);
+            *--dst = samples[i];
           }
         }
       }
-
-      return samples - buffer->data;
+      mixSamples(buffer->data, samples, count, fade+2-volume);
+      return count;
     }
   }
 
@@ -556,6 +1155,11 @@ int WavContext::mixBuffer(AudioBuffer *buffer, int volume, unsigned int fade)
   return 0;
 }
 #else
+void WavContext::close()
+{
+  clear();
+}
+
 int WavContext::mixBuffer(AudioBuffer *buffer, int volume, unsigned int fade)
 {
   return 0;
@@ -563,15 +1167,26 @@ int WavContext::mixBuffer(AudioBuffer *buffer, int volume, unsigned int fade)
 #endif
 
 const uint8_t toneVolumes[] = { 10, 8, 6, 4, 2 };
-inline float evalVolumeRatio(int freq, int volume)
+
+// Q16 gain of the tones, the low frequencies are amplified up to full
+// scale: a larger gain would overflow the samples
+inline int32_t evalToneGain(int freq, int volume)
 {
-  float result = toneVolumes[2+volume];
+  uint64_t divisor = toneVolumes[2+volume];
+  uint64_t gain = (uint64_t)65536;
   if (freq < 330) {
-    result = (result * freq * freq) / (330 * 330);
+    gain *= 330 * 330;
+    divisor *= freq * freq;
   }
-  return result;
+  return min<uint64_t>(gain / divisor, 65536);
 }
 
+#if defined(AUDIO_TONE_RAMP)
+// the tones are faded in and out over 2ms
+#define TONE_RAMP_BITS    6
+static_assert((1 << TONE_RAMP_BITS) == AUDIO_SAMPLE_RATE / 500, "Invalid tone ramp length");
+#endif
+
 int ToneContext::mixBuffer(AudioBuffer * buffer, int volume, unsigned int fade)
 {
   int duration = 0;
@@ -583,7 +1198,7 @@ int ToneContext::mixBuffer(AudioBuffer * buffer, int volume, unsigned int fade)
   int remainingDuration = fragment.tone.duration - state.duration;
   if (remainingDuration > 0) {
     int points;
-    float toneIdx = state.idx;
+    uint32_t phase = state.phase;
 
     if (fragment.tone.reset) {
       fragment.tone.reset = 0;
@@ -593,8 +1208,9 @@ int ToneContext::mixBuffer(AudioBuffer * buffer, int volume, unsigned int fade)
 
     if (fragment.tone.freq != state.freq) {
       state.freq = fragment.tone.freq;
-      state.step = limit<float>(1, float(fragment.tone.freq) * (float(DIM(sineValues))/float(AUDIO_SAMPLE_RATE)), 512);
-      state.volume = 1.0f / evalVolumeRatio(fragment.tone.freq, volume);
+      // from 1 table entry to half the table per sample
+      state.step = limit<uint64_t>(1u << (32 - TONE_TABLE_BITS), ((uint64_t)fragment.tone.freq << 32) / AUDIO_SAMPLE_RATE, 1u << 31);
+      state.gain = evalToneGain(fragment.tone.freq, volume);
     }
 
     if (fragment.tone.freqIncr) {
@@ -622,25 +1238,36 @@ int ToneContext::mixBuffer(AudioBuffer * buffer, int volume, unsigned int fade)
     else {
       duration = remainingDuration;
       points = (duration * AUDIO_BUFFER_SIZE) / AUDIO_BUFFER_DURATION;
-      unsigned int end = toneIdx + (state.step * points);
-      if (end > DIM(sineValues))
-        end -= (end % DIM(sineValues));
-      else
-        end = DIM(sineValues);
-      points = (float(end) - toneIdx) / state.step;
+      // the tone stops at the end of a period
+      uint64_t end = phase + (uint64_t)state.step * points;
+      end = (end >> 32) ? (end >> 32) << 32 : (uint64_t)1 << 32;
+      points = min<uint64_t>((end - phase) / state.step, AUDIO_BUFFER_SIZE);
     }
 
+    int16_t * samples = (int16_t *)wavBuffer;
     for (int i=0; i<points; i++) {
-      int16_t sample = sineValues[int(toneIdx)] * state.volume;
-      mixSample(&buffer->data[i], sample, fade);
-      toneIdx += state.step;
-      if ((unsigned int)toneIdx >= DIM(sineValues))
-        toneIdx -= DIM(sineValues);
+      samples[i] = (sineValues[phase >> (32 - TONE_TABLE_BITS)] * state.gain) >> 16;
+      phase += state.step;
     }
 
+#if defined(AUDIO_TONE_RAMP)
+    if (state.duration == 0) {
+      for (int i=0; i<points && i<(1 << TONE_RAMP_BITS); i++) {
+        samples[i] = (samples[i] * i) >> TONE_RAMP_BITS;
+      }
+    }
+    if (remainingDuration <= AUDIO_BUFFER_DURATION) {
+      for (int i=max(0, points-(1 << TONE_RAMP_BITS)); i<points; i++) {
+        samples[i] = (samples[i] * (points - i)) >> TONE_RAMP_BITS;
+      }
+    }
+#endif
+
+    mixSamples(buffer->data, samples, points, fade);
+
     if (remainingDuration > AUDIO_BUFFER_DURATION) {
       state.duration += AUDIO_BUFFER_DURATION;
-      state.idx = toneIdx;
+      state.phase = phase;
       return AUDIO_BUFFER_SIZE;
     }
     else {
@@ -666,6 +1293,15 @@ void AudioQueue::wakeup()
   audioConsumeCurrentBuffer();
   DEBUG_TIMER_STOP(debugTimerAudioConsume);
 
+  // when the samples were coming faster than played, the buffers
+  // should never be all played
+  bool starved = false;
+  if (streaming) {
+    uint8_t filled = buffersFifo.filled();
+    audioStats.fillLevel[filled]++;
+    starved = (filled == 0);
+  }
+
   AudioBuffer * buffer;
   while ((buffer = buffersFifo.getEmptyBuffer()) != nullptr) {
     int result;
@@ -673,9 +1309,7 @@ void AudioQueue::wakeup()
     int size = 0;
 
     // write silence in the buffer
-    for (uint32_t i=0; i<AUDIO_BUFFER_SIZE; i++) {
-      buffer->data[i] = AUDIO_DATA_SILENCE; /* silence */
-    }
+    audioFill(buffer->data, AUDIO_BUFFER_SIZE, AUDIO_DATA_SILENCE);
 
     // mix the priority context (only tones)
     result = priorityContext.mixBuffer(buffer, g_eeGeneral.beepVolume, fade);
@@ -687,7 +1321,36 @@ void AudioQueue::wakeup()
     // mix the normal context (tones and wavs)
     if (normalContext.isEmpty() && !fragmentsFifo.empty()) {
       RTOS_LOCK_MUTEX(audioMutex);
-      normalContext.setFragment(fragmentsFifo.get());
+      uint32_t queued;
+      const AudioFragment * fragment = fragmentsFifo.get(&queued);
+      if (queued) {
+        // the buffers already filled are played before this fragment
+        uint32_t wait = RTOS_GET_MS() - queued + buffersFifo.filled() * AUDIO_BUFFER_DURATION;
+        audioStatsRecord(audioStats.queueWait, wait, AUDIO_STATS_QUEUE_WAIT_BASE);
+        audioStats.maxQueueWait = max<uint32_t>(audioStats.maxQueueWait, min<uint32_t>(wait, UINT16_MAX));
+      }
+#if defined(AUDIO_PHRASE_CACHE)
+      const AudioPhraseCache::Entry * phrase = audioPhraseCache.start(*fragment);
+      if (phrase) {
+        // the other files of the phrase are in the cached samples
+        fragmentsFifo.skip(fragment->phraseLength - 1);
+        normalContext.setFragment(fragment);
+        normalContext.setPhrase(phrase->samples, phrase->count, phrase->freq);
+      }
+      else
+#endif
+      // the prefetched fragment may have been removed from the queue since
+      if (fragment == prefetchedFragment && fragment->type == FRAGMENT_FILE &&
+          prefetchedContext.hasPromptId(fragment->id) && !prefetchedContext.isEmpty()) {
+        normalContext.setWav(prefetchedContext);
+        // the file is now the one of normalContext
+        prefetchedContext.clear();
+      }
+      else {
+        normalContext.setFragment(fragment);
+      }
+      prefetchedContext.close();
+      prefetchedFragment = nullptr;
       RTOS_UNLOCK_MUTEX(audioMutex);
     }
     result = normalContext.mixBuffer(buffer, g_eeGeneral.beepVolume, g_eeGeneral.wavVolume, fade);
@@ -716,15 +1379,18 @@ void AudioQueue::wakeup()
       // TRACE("pushing buffer %p", buffer);
       buffer->size = size;
 
+      if (starved) {
+        audioStats.underruns++;
+        starved = false;
+      }
+
 #if defined(SOFTWARE_VOLUME)
       if (currentSpeakerVolume > 0) {
-        for (uint32_t i=0; i<buffer->size; ++i) {
-          int32_t tmpSample = (int32_t) ((uint32_t) (buffer->data[i]) - AUDIO_DATA_SILENCE);  // conversion from uint16_t
-          buffer->data[i] = (int16_t) (((tmpSample * currentSpeakerVolume) / VOLUME_LEVEL_MAX) + AUDIO_DATA_SILENCE);
-        }
+        audioScale(buffer->data, buffer->size, (currentSpeakerVolume << 16) / VOLUME_LEVEL_MAX);
         buffersFifo.audioPushBuffer();
       }
       else {
+        streaming = false;
         break;
       }
 #else
@@ -733,14 +1399,55 @@ void AudioQueue::wakeup()
     }
     else {
       // break the endless loop
+      streaming = false;
       break;
     }
     DEBUG_TIMER_START(debugTimerAudioConsume);
     audioConsumeCurrentBuffer();
     DEBUG_TIMER_STOP(debugTimerAudioConsume);
+    audioStats.buffers++;
+    streaming = true;
   }
+
+#if defined(SDCARD)
+  // the buffers are full, the best time to open the next file
+  prefetchNextFragment();
+#endif
 }
 
+#if defined(SDCARD)
+// f_open() and the parsing of the header of the next prompt are done while
+// the current one plays, so that phrases made of several files (numbers,
+// units) are played without gaps
+void AudioQueue::prefetchNextFragment()
+{
+  if (!normalContext.isFile() || prefetchedFragment)
+    return;
+
+  RTOS_LOCK_MUTEX(audioMutex);
+  const AudioFragment * next = fragmentsFifo.peek();
+#if defined(AUDIO_PHRASE_CACHE)
+  // no file to open for the cached phrases
+  if (next && audioPhraseCache.isCached(*next)) {
+    next = nullptr;
+  }
+#endif
+  if (next && next->type == FRAGMENT_FILE) {
+    // the file of a flushed fragment may still be open
+    prefetchedContext.close();
+    // copied as a whole, for its phrase tag
+    prefetchedContext.setFragment(*next);
+    prefetchedFragment = next;
+  }
+  RTOS_UNLOCK_MUTEX(audioMutex);
+
+  // a file which could not be opened is not retried before its turn
+  if (prefetchedFragment) {
+    prefetchedContext.prefetch();
+  }
+}
+#endif
+
 inline unsigned int getToneLength(uint16_t len)
 {
   unsigned int result = len; // default
@@ -790,7 +1497,7 @@ void AudioQueue::playTone(uint16_t freq, uint16_t len, uint16_t pause, uint8_t f
       }
     }
     else {
-      fragmentsFifo.push(AudioFragment(freq, len, pause, flags & 0x0f, freqIncr, false, fragmentVolume));
+      fragmentsFifo.push(AudioFragment(freq, len, pause, flags & 0x0f, freqIncr, false, fragmentVolume), RTOS_GET_MS());
     }
   }
 
@@ -829,7 +1536,7 @@ void AudioQueue::playFile(const char * filename, uint8_t flags, uint8_t id, int8
     backgroundContext.setFragment(filename, 0, fragmentVolume, id);
   }
   else {
-    fragmentsFifo.push(AudioFragment(filename, flags & 0x0f, fragmentVolume, id));
+    fragmentsFifo.push(AudioFragment(filename, flags & 0x0f, fragmentVolume, id), RTOS_GET_MS());
   }
 
   RTOS_UNLOCK_MUTEX(audioMutex);
@@ -855,11 +1562,35 @@ void AudioQueue::stopPlay(uint8_t id)
 
 void AudioQueue::stopSD()
 {
-  sdAvailableSystemAudioFiles.reset();
+  resetAudioFilesCache();
+#if defined(AUDIO_PHRASE_CACHE)
+  audioPhraseCache.requestReset();
+#endif
   stopAll();
   playTone(0, 0, 100, PLAY_NOW);        // insert a 100ms pause
 }
 
+void audioFileChanged(const char * path)
+{
+  char cwd[FF_MAX_LFN + 1];
+  if (path[0] != '/') {
+    if (f_getcwd(cwd, sizeof(cwd)) != FR_OK)
+      return;
+    path = cwd;
+  }
+
+  // "/SOUNDS", the directory above the languages
+  if (strncasecmp(path, SOUNDS_PATH, SOUNDS_PATH_LNG_OFS - 1))
+    return;
+
+  resetAudioFilesCache();
+#if defined(AUDIO_PHRASE_CACHE)
+  audioPhraseCache.requestReset();
+#endif
+  referenceSystemAudioFiles();
+  referenceModelAudioFiles();
+}
+
 #endif
 
 void AudioQueue::stopAll()
@@ -875,6 +1606,8 @@ void AudioQueue::flush()
 {
   RTOS_LOCK_MUTEX(audioMutex);
   fragmentsFifo.clear();
+  // the prefetched file is closed by the audio task, which may be opening it
+  prefetchedFragment = nullptr;
   varioContext.clear();
   backgroundContext.clear();
   RTOS_UNLOCK_MUTEX(audioMutex);
@@ -1150,14 +1883,131 @@ void audioEvent(unsigned int index)
   }
 }
 
+#if defined(SDCARD)
+static void getUnitFilename(char * filename, uint8_t unit, uint8_t idx)
+{
+  char * tmp = strAppendSystemAudioPath(filename);
+  tmp = strAppendStringWithIndex(tmp, unitsFilenames[unit], idx);
+  strcpy(tmp, SOUNDS_EXT);
+}
+
+static void getPromptFilename(char * filename, uint16_t prompt)
+{
+  char * str = strAppendSystemAudioPath(filename);
+  strcpy(str, "0000" SOUNDS_EXT);
+  for (int8_t i=3; i>=0; i--) {
+    str[i] = '0' + (prompt%10);
+    prompt /= 10;
+  }
+}
+#endif
+
+#if defined(AUDIO_PHRASE_CACHE)
+#define AUDIO_PHRASE_NUMBER     0
+#define AUDIO_PHRASE_DURATION   1
+#define AUDIO_PHRASE_UNIT       0x8000  // AudioPhrase prompts: unit << 8 | idx
+
+// the phrase built by the language pack, audioMutex being held
+static AudioPhrase * currentPhrase;
+
+static void pushPhrasePrompt(uint16_t prompt)
+{
+  if (currentPhrase->count < AUDIO_PHRASE_MAX_FILES) {
+    currentPhrase->prompts[currentPhrase->count++] = prompt;
+  }
+}
+
+// The phrases are identified by the language and the parameters of the
+// language pack function
+static uint32_t audioPhraseKey(uint8_t type, int32_t value, uint8_t unit, uint8_t flags)
+{
+  const uint8_t data[] = { type, unit, flags, (uint8_t)value, (uint8_t)(value >> 8),
+                           (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+  uint32_t key = audioHashUpdate(AUDIO_HASH_INIT, currentLanguagePack->id, 2);
+  for (uint8_t byte : data) {
+    key = (key ^ byte) * 16777619u;
+  }
+  return key ? key : 1;  // 0 is for the fragments out of a phrase
+}
+
+void AudioQueue::playPhrase(const AudioPhrase & phrase, uint8_t id, int8_t fragmentVolume)
+{
+#if defined(SIMU) && !defined(SIMU_AUDIO)
+  return;
+#endif
+
+  if (!sdMounted())
+    return;
+
+  if (g_eeGeneral.beepMode == e_mode_quiet)
+    return;
+
+  RTOS_LOCK_MUTEX(audioMutex);
+
+  // the cached samples may only replace a phrase entirely queued
+  bool complete = (phrase.count <= fragmentsFifo.space());
+  for (uint8_t i = 0; i < phrase.count; i++) {
+    char filename[AUDIO_FILENAME_MAXLEN+1];
+    uint16_t prompt = phrase.prompts[i];
+    if (prompt & AUDIO_PHRASE_UNIT)
+      getUnitFilename(filename, (prompt >> 8) & 0x7f, prompt & 0xff);
+    else
+      getPromptFilename(filename, prompt);
+    AudioFragment fragment(filename, 0, fragmentVolume, id);
+    if (complete) {
+      fragment.phrase = phrase.key;
+      fragment.phraseIndex = i;
+      fragment.phraseLength = phrase.count;
+    }
+    fragmentsFifo.push(fragment, RTOS_GET_MS());
+  }
+
+  RTOS_UNLOCK_MUTEX(audioMutex);
+}
+
+void playNumber(getvalue_t number, uint8_t unit, uint8_t flags, uint8_t id, int8_t fragmentVolume)
+{
+  AudioPhrase phrase;
+  phrase.key = audioPhraseKey(AUDIO_PHRASE_NUMBER, number, unit, flags);
+  phrase.count = 0;
+
+  RTOS_LOCK_MUTEX(audioMutex);
+  currentPhrase = &phrase;
+  currentLanguagePack->playNumber(number, unit, flags, id, fragmentVolume);
+  currentPhrase = nullptr;
+  RTOS_UNLOCK_MUTEX(audioMutex);
+
+  audioQueue.playPhrase(phrase, id, fragmentVolume);
+}
+
+void playDuration(int seconds, uint8_t flags, uint8_t id, int8_t fragmentVolume)
+{
+  AudioPhrase phrase;
+  phrase.key = audioPhraseKey(AUDIO_PHRASE_DURATION, seconds, 0, flags);
+  phrase.count = 0;
+
+  RTOS_LOCK_MUTEX(audioMutex);
+  currentPhrase = &phrase;
+  currentLanguagePack->playDuration(seconds, flags, id, fragmentVolume);
+  currentPhrase = nullptr;
+  RTOS_UNLOCK_MUTEX(audioMutex);
+
+  audioQueue.playPhrase(phrase, id, fragmentVolume);
+}
+#endif
+
 #if defined(SDCARD)
 void pushUnit(uint8_t unit, uint8_t idx, uint8_t id, uint8_t fragmentVolume)
 {
   if (unit < DIM(unitsFilenames)) {
+#if defined(AUDIO_PHRASE_CACHE)
+    if (currentPhrase) {
+      pushPhrasePrompt(AUDIO_PHRASE_UNIT | (unit << 8) | idx);
+      return;
+    }
+#endif
     char path[AUDIO_FILENAME_MAXLEN+1];
-    char * tmp = strAppendSystemAudioPath(path);
-    tmp = strAppendStringWithIndex(tmp, unitsFilenames[unit], idx);
-    strcpy(tmp, SOUNDS_EXT);
+    getUnitFilename(path, unit, idx);
     audioQueue.playFile(path, 0, id, fragmentVolume);
   }
   else {
@@ -1169,13 +2019,14 @@ void pushUnit(uint8_t unit, uint8_t idx, uint8_t id, uint8_t fragmentVolume)
 void pushPrompt(uint16_t prompt, uint8_t id, uint8_t fragmentVolume)
 {
 #if defined(SDCARD)
-  char filename[AUDIO_FILENAME_MAXLEN+1];
-  char * str = strAppendSystemAudioPath(filename);
-  strcpy(str, "0000" SOUNDS_EXT);
-  for (int8_t i=3; i>=0; i--) {
-    str[i] = '0' + (prompt%10);
-    prompt /= 10;
+#if defined(AUDIO_PHRASE_CACHE)
+  if (currentPhrase) {
+    pushPhrasePrompt(prompt);
+    return;
   }
+#endif
+  char filename[AUDIO_FILENAME_MAXLEN+1];
+  getPromptFilename(filename, prompt);
   audioQueue.playFile(filename, 0, id, fragmentVolume);
 #endif
 }
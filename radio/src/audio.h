@@ -75,11 +75,25 @@ constexpr uint8_t AUDIO_FILENAME_MAXLEN = (AUDIO_LUA_FILENAME_MAXLEN > AUDIO_MOD
 
 #define AUDIO_QUEUE_LENGTH             (16) // must be a power of 2!
 
+#if defined(AUDIO_PHRASE_CACHE)
+  #if !defined(AUDIO_PHRASE_CACHE_SIZE)
+    #define AUDIO_PHRASE_CACHE_SIZE      (512*1024) // bytes of samples
+  #endif
+  #define AUDIO_PHRASE_CACHE_ENTRIES     16
+  #define AUDIO_PHRASE_MAX_DURATION      6000 // ms
+  #define AUDIO_PHRASE_MAX_FILES         (AUDIO_QUEUE_LENGTH - 1)
+#endif
+
 #define AUDIO_SAMPLE_RATE              (32000)
-#define AUDIO_BUFFER_DURATION          (10)
+// both may be set by the target (AUDIO_BUFFER_COUNT and AUDIO_BUFFER_DURATION
+// cmake options)
+#if !defined(AUDIO_BUFFER_DURATION)
+  #define AUDIO_BUFFER_DURATION        (10) // ms
+#endif
 #define AUDIO_BUFFER_SIZE              (AUDIO_SAMPLE_RATE*AUDIO_BUFFER_DURATION/1000)
 
-#if defined(SIMU) && defined(SIMU_AUDIO)
+#if defined(AUDIO_BUFFER_COUNT)
+#elif defined(SIMU) && defined(SIMU_AUDIO)
   #define AUDIO_BUFFER_COUNT           (10) // simulator needs more buffers for smooth audio
 #elif defined(PCBX12S)
   #define AUDIO_BUFFER_COUNT           (2)  // smaller than Taranis since there is also a buffer on the ADC chip
@@ -159,6 +173,14 @@ struct AudioFragment {
   uint8_t id;
   uint8_t repeat;
   int8_t fragmentVolume;
+#if defined(AUDIO_PHRASE_CACHE)
+  // the files of a number phrase are queued together, the first one
+  // being replaced by the cached samples of the whole phrase
+  uint8_t phraseIndex = 0;
+  uint8_t phraseLength = 0;
+  uint32_t phrase = 0;
+#endif
+  uint32_t queued = 0; // ms, when pushed in the queue
   union {
     Tone tone;
     char file[AUDIO_FILENAME_MAXLEN+1];
@@ -191,6 +213,10 @@ struct AudioFragment {
   }
 };
 
+// one period of the tones waveform
+#define TONE_TABLE_BITS                10
+extern const int16_t sineValues[1 << TONE_TABLE_BITS];
+
 class ToneContext {
   public:
 
@@ -217,9 +243,9 @@ class ToneContext {
     AudioFragment fragment;
 
     struct {
-      float step;
-      float idx;
-      float  volume;
+      uint32_t step;    // one table period is 2^32
+      uint32_t phase;
+      int32_t  gain;    // Q16
       uint16_t freq;
       uint16_t duration;
       uint16_t pause;
@@ -231,15 +257,27 @@ class WavContext {
   public:
 
     inline void clear() { fragment.clear(); };
+    void close();
 
     int mixBuffer(AudioBuffer *buffer, int volume, unsigned int fade);
+    bool prefetch();
+    bool isEmpty() const { return fragment.type == FRAGMENT_EMPTY; };
     bool hasPromptId(uint8_t id) const { return fragment.id == id; };
 
     void setFragment(const char * filename, uint8_t repeat, int8_t fragmentVolume, uint8_t id)
     {
-      fragment = AudioFragment(filename, repeat, id, fragmentVolume);
+      fragment = AudioFragment(filename, repeat, fragmentVolume, id);
     }
 
+    void setFragment(const AudioFragment & frag)
+    {
+      fragment = frag;
+    }
+
+#if defined(AUDIO_PHRASE_CACHE)
+    void setPhrase(const int16_t * samples, uint32_t count, uint32_t freq);
+#endif
+
     void stop(uint8_t id)
     {
       if (fragment.id == id) {
@@ -250,13 +288,28 @@ class WavContext {
   private:
     AudioFragment fragment;
 
+    FRESULT openFile();
+    FRESULT setSampleRate(uint32_t freq);
+    FRESULT readSamples(int16_t * samples, uint32_t count, uint32_t * read);
+    uint32_t interpolateBuffer(AudioBuffer * buffer, uint32_t read, unsigned int fade);
+
     struct {
       FIL      file;
       uint8_t  codec;
       uint32_t freq;
       uint32_t size;
-      uint8_t  resampleRatio;
-      uint16_t readSize;
+      uint8_t  resampleRatio;     // 0 when interpolated
+      uint16_t blockAlign;        // IMA-ADPCM block size
+      uint16_t blockRemaining;    // IMA-ADPCM bytes left in the block
+      int16_t  predictor;         // IMA-ADPCM last sample
+      uint8_t  stepIndex;
+      uint8_t  nibble;            // 0x10 | the high nibble not decoded yet
+      uint32_t step;              // interpolation: input samples per output sample (Q16)
+      uint32_t position;          // from history[0] (Q16)
+      int16_t  history[2];        // last 2 input samples
+#if defined(AUDIO_PHRASE_CACHE)
+      const int16_t * memory;     // cached phrase samples, instead of the file
+#endif
     } state;
 };
 
@@ -278,6 +331,18 @@ class MixedContext {
       }
     }
 
+    void setWav(const WavContext & context)
+    {
+      wav = context;
+    }
+
+#if defined(AUDIO_PHRASE_CACHE)
+    void setPhrase(const int16_t * samples, uint32_t count, uint32_t freq)
+    {
+      wav.setPhrase(samples, count, freq);
+    }
+#endif
+
     inline void clear()
     {
       tone.clear();   // the biggest member of the uninon
@@ -335,7 +400,7 @@ class AudioBufferFifo {
 
     uint8_t used() const
     {
-      return bufferFull ? AUDIO_BUFFER_COUNT : writeIdx - readIdx;
+      return bufferFull ? AUDIO_BUFFER_COUNT : (writeIdx + AUDIO_BUFFER_COUNT - readIdx) % AUDIO_BUFFER_COUNT;
     }
 
   public:
@@ -422,6 +487,21 @@ class AudioBufferFifo {
 #endif
     }
 
+    // the buffers not yet played, the one being played included
+    uint8_t filled() const
+    {
+#if defined(AUDIO_DUAL_BUFFER)
+      uint8_t count = 0;
+      for (int n = 0; n < AUDIO_BUFFER_COUNT; ++n) {
+        if (audioBuffers[n].state != AUDIO_BUFFER_FREE) {
+          count++;
+        }
+      }
+      return count;
+#else
+      return used();
+#endif
+    }
 };
 
 class AudioFragmentFifo
@@ -474,15 +554,38 @@ class AudioFragmentFifo
       return ridx == nextIdx(widx);
     }
 
+    uint8_t space() const
+    {
+      return (ridx - widx - 1) & (AUDIO_QUEUE_LENGTH - 1);
+    }
+
+    // drops the fragments following the one returned by get()
+    void skip(uint8_t count)
+    {
+      while (count-- && !empty()) {
+        ridx = nextIdx(ridx);
+      }
+    }
+
     void clear()
     {
       widx = ridx;                      // clean the queue
     }
 
-    const AudioFragment * get()
+    const AudioFragment * peek() const
+    {
+      return empty() ? nullptr : &fragments[ridx];
+    }
+
+    // queued is the time the fragment was pushed, 0 for its repetitions
+    const AudioFragment * get(uint32_t * queued = nullptr)
     {
       if (!empty()) {
-        const AudioFragment * result = &fragments[ridx];
+        AudioFragment * result = &fragments[ridx];
+        if (queued) {
+          *queued = result->queued;
+        }
+        result->queued = 0;
         if (!fragments[ridx].repeat--) {
           // repeat is done, move to the next fragment
           ridx = nextIdx(ridx);
@@ -492,17 +595,28 @@ class AudioFragmentFifo
       return 0;
     }
 
-    void push(const AudioFragment & fragment)
+    void push(const AudioFragment & fragment, uint32_t now)
     {
       if (!full()) {
         // TRACE("fragment %d at %d", fragment.type, widx);
         fragments[widx] = fragment;
+        fragments[widx].queued = now;
         widx = nextIdx(widx);
       }
     }
 
 };
 
+#if defined(AUDIO_PHRASE_CACHE)
+// The prompts pushed by the language pack for a playNumber() or a
+// playDuration(), queued together once the phrase is complete
+struct AudioPhrase {
+  uint32_t key;
+  uint8_t count;
+  uint16_t prompts[AUDIO_PHRASE_MAX_FILES];
+};
+#endif
+
 class AudioQueue {
 
 #if defined(SIMU_AUDIO)
@@ -516,6 +630,9 @@ class AudioQueue {
     void start() { _started = true; };
     void playTone(uint16_t freq, uint16_t len, uint16_t pause=0, uint8_t flags=0, int8_t freqIncr=0, int8_t fragmentVolume = USE_SETTINGS_VOLUME);
     void playFile(const char *filename, uint8_t flags=0, uint8_t id=0, int8_t fragmentVolume = USE_SETTINGS_VOLUME);
+#if defined(AUDIO_PHRASE_CACHE)
+    void playPhrase(const AudioPhrase & phrase, uint8_t id, int8_t fragmentVolume);
+#endif
     void stopPlay(uint8_t id);
     void stopAll();
     void flush();
@@ -524,6 +641,7 @@ class AudioQueue {
     bool isPlaying(uint8_t id);
     bool isEmpty() const { return fragmentsFifo.empty(); };
     void wakeup();
+    void prefetchNextFragment();
     bool started() const { return _started; };
 #if defined(AUDIO_UNMUTE_DELAY)
     tmr10ms_t lastAudioPlayTime = 0;
@@ -538,8 +656,35 @@ class AudioQueue {
     ToneContext  priorityContext;
     ToneContext  varioContext;
     AudioFragmentFifo fragmentsFifo;
+    // the next file of fragmentsFifo, opened while normalContext plays
+    WavContext   prefetchedContext;
+    const AudioFragment * prefetchedFragment;
+    // the last wakeup() stopped on full buffers, more samples were coming
+    bool streaming;
 };
 
+// Histograms of the audio pipeline, the bins are powers of 2 of their base
+#define AUDIO_STATS_BINS               8
+#define AUDIO_STATS_QUEUE_WAIT_BASE    10  // ms
+#define AUDIO_STATS_DECODE_TIME_BASE   250 // us
+
+struct AudioStats {
+  uint32_t buffers;                           // pushed while streaming
+  uint32_t underruns;                         // buffers all played while streaming
+  uint32_t queueWait[AUDIO_STATS_BINS];       // from the queue to the speaker
+  uint32_t decodeTime[AUDIO_STATS_BINS];      // file reads and decoding, per buffer
+  uint32_t fillLevel[AUDIO_BUFFER_COUNT + 1]; // buffers ahead of each wakeup
+  uint16_t maxQueueWait;                      // ms
+  uint16_t maxDecodeTime;                     // us
+
+  void reset()
+  {
+    memset(reinterpret_cast<void*>(this), 0, sizeof(AudioStats));
+  }
+};
+
+extern AudioStats audioStats;
+
 extern uint8_t currentSpeakerVolume;
 extern AudioQueue audioQueue;
 
@@ -625,8 +770,10 @@ void playModelName();
 #define I18N_PLAY_FUNCTION(lng, x, ...) void lng ## _ ## x(__VA_ARGS__, uint8_t id, int8_t fragmentVolume = USE_SETTINGS_VOLUME)
 #define PUSH_NUMBER_PROMPT(p)    pushPrompt((p), id, fragmentVolume)
 #define PUSH_UNIT_PROMPT(p, i)   pushUnit((p), (i), id, fragmentVolume)
-#define PLAY_NUMBER(n, u, a)     playNumber((n), (u), (a), id, fragmentVolume)
-#define PLAY_DURATION(d, att)    playDuration((d), (att), id, fragmentVolume)
+// the language packs call each other directly, the phrases being built by
+// playNumber() and playDuration()
+#define PLAY_NUMBER(n, u, a)     currentLanguagePack->playNumber((n), (u), (a), id, fragmentVolume)
+#define PLAY_DURATION(d, att)    currentLanguagePack->playDuration((d), (att), id, fragmentVolume)
 #define PLAY_DURATION_ATT        , uint8_t flags
 #define PLAY_TIME                1
 #define PLAY_LONG_TIMER          2
@@ -665,6 +812,10 @@ char * getAudioPath(char * path);
 
 void referenceSystemAudioFiles();
 void referenceModelAudioFiles();
+void resetAudioFilesCache();
+// a file was written, renamed or deleted outside of the audio code,
+// the path may be relative to the current directory
+void audioFileChanged(const char * path);
 
 bool isAudioFileReferenced(uint32_t i, char * filename/*at least AUDIO_FILENAME_MAXLEN+1 long*/);
 
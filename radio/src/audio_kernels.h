@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) EdgeTX
+ *
+ * Based on code named
+ *   opentx - https://github.com/opentx/opentx
+ *   th9x - http://code.google.com/p/th9x
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "audio.h"
+#include "opentx_helpers.h"
+
+// Block kernels used to build the audio buffers. Buffers are 4-byte
+// aligned, the DSP versions process 2 samples per instruction (Cortex-M4)
+// or 8 (SSE2 on the simulator), the others are the reference ones
+
+#define AUDIO_DATA_PAIR(value) \
+  ((uint32_t)(uint16_t)(value) | ((uint32_t)(uint16_t)(value) << 16))
+
+#if defined(SIMU) && defined(__SSE2__)
+  #include <emmintrin.h>
+  #define AUDIO_KERNELS_SSE2
+#elif !defined(SIMU) && defined(__ARM_FEATURE_DSP)
+  #define AUDIO_KERNELS_DSP
+#endif
+
+#if defined(AUDIO_KERNELS_DSP)
+// CMSIS has no intrinsic for these ones: (a * b[15:0]) >> 16 and
+// (a * b[31:16]) >> 16, b halves being signed
+static inline int32_t smulwb(int32_t a, uint32_t b)
+{
+  int32_t result;
+  __asm__ ("smulwb %0, %1, %2" : "=r" (result) : "r" (a), "r" (b));
+  return result;
+}
+
+static inline int32_t smulwt(int32_t a, uint32_t b)
+{
+  int32_t result;
+  __asm__ ("smulwt %0, %1, %2" : "=r" (result) : "r" (a), "r" (b));
+  return result;
+}
+
+// (sample * gain) >> 16 on both halves of a samples pair
+static inline uint32_t audioScalePair(uint32_t pair, int32_t gain)
+{
+  return __PKHBT(smulwb(gain, pair), smulwt(gain, pair), 16);
+}
+
+#endif
+
+// Q16 gain of a right shift, gains are 0..65536
+constexpr int32_t audioShiftGain(unsigned shift)
+{
+  return shift >= 17 ? 0 : (int32_t)(0x10000u >> shift);
+}
+
+inline void audioFill(audio_data_t * data, uint32_t count, audio_data_t value)
+{
+  uint32_t pair = AUDIO_DATA_PAIR(value);
+  uint32_t * dst = (uint32_t *)data;
+  for (uint32_t i = 0; i < count / 2; i++) {
+    dst[i] = pair;
+  }
+  if (count & 1) {
+    data[count - 1] = value;
+  }
+}
+
+// data[i] = limit(AUDIO_DATA_MIN, data[i] + (samples[i] >> shift), AUDIO_DATA_MAX),
+// shift including the conversion to AUDIO_BITS_PER_SAMPLE
+inline void audioMix(audio_data_t * data, const int16_t * samples,
+                     uint32_t count, unsigned shift)
+{
+  uint32_t i = 0;
+
+#if defined(AUDIO_KERNELS_SSE2)
+  // offset binary, moved to signed to use the saturated add
+  const __m128i bias = _mm_set1_epi16((int16_t)AUDIO_DATA_SILENCE);
+  const __m128i n = _mm_cvtsi32_si128(shift > 15 ? 15 : shift);
+  for (; i + 8 <= count; i += 8) {
+    __m128i d = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&data[i]), bias);
+    __m128i s = _mm_sra_epi16(_mm_loadu_si128((const __m128i *)&samples[i]), n);
+    _mm_storeu_si128((__m128i *)&data[i], _mm_xor_si128(_mm_adds_epi16(d, s), bias));
+  }
+#elif defined(AUDIO_KERNELS_DSP)
+  const int32_t gain = audioShiftGain(shift);
+  uint32_t * dst = (uint32_t *)data;
+  const uint32_t * src = (const uint32_t *)samples;
+  for (; i + 2 <= count; i += 2) {
+    uint32_t s = audioScalePair(*src++, gain);
+#if AUDIO_DATA_SILENCE == 0
+    *dst = __QADD16(*dst, s);
+#else
+    *dst = __USAT16(__SADD16(*dst, s), AUDIO_BITS_PER_SAMPLE);
+#endif
+    dst++;
+  }
+#endif
+
+  for (; i < count; i++) {
+    data[i] = limit<int32_t>(AUDIO_DATA_MIN, data[i] + (samples[i] >> shift), AUDIO_DATA_MAX);
+  }
+}
+
+// data[i] = ((data[i] - AUDIO_DATA_SILENCE) * gain >> 16) + AUDIO_DATA_SILENCE
+inline void audioScale(audio_data_t * data, uint32_t count, int32_t gain)
+{
+  if (gain >= 0x10000) {
+    return;
+  }
+
+  uint32_t i = 0;
+
+#if defined(AUDIO_KERNELS_SSE2)
+  // mulhi is signed: gains above INT16_MAX are seen as gain - 65536,
+  // which is compensated by adding the sample back
+  const __m128i bias = _mm_set1_epi16((int16_t)AUDIO_DATA_SILENCE);
+  const __m128i g = _mm_set1_epi16((int16_t)gain);
+  const __m128i compensation = _mm_set1_epi16(gain >= 0x8000 ? -1 : 0);
+  for (; i + 8 <= count; i += 8) {
+    __m128i d = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&data[i]), bias);
+    __m128i r = _mm_add_epi16(_mm_mulhi_epi16(d, g), _mm_and_si128(d, compensation));
+    _mm_storeu_si128((__m128i *)&data[i], _mm_xor_si128(r, bias));
+  }
+#elif defined(AUDIO_KERNELS_DSP)
+  uint32_t * dst = (uint32_t *)data;
+  for (; i + 2 <= count; i += 2) {
+#if AUDIO_DATA_SILENCE == 0
+    *dst = audioScalePair(*dst, gain);
+#else
+    const uint32_t silence = AUDIO_DATA_PAIR(AUDIO_DATA_SILENCE);
+    *dst = __SADD16(audioScalePair(__SSUB16(*dst, silence), gain), silence);
+#endif
+    dst++;
+  }
+#endif
+
+  for (; i < count; i++) {
+    data[i] = (((int32_t)data[i] - AUDIO_DATA_SILENCE) * gain >> 16) + AUDIO_DATA_SILENCE;
+  }
+}
@@ -38,6 +38,18 @@
 #include "tasks.h"
 #include "tasks/mixer_task.h"
 
+#if defined(STORAGE_USE_SPI_FLASH) && !defined(DISABLE_FLASH_FTL)
+#include "diskio_spi_flash.h"
+#endif
+
+#if defined(SDCARD_YAML)
+#include "storage/sdcard_yaml.h"
+#endif
+
+#if defined(LOGS_BINARY)
+#include "logs_binary.h"
+#endif
+
 #include "cli.h"
 
 #include <ctype.h>
@@ -1256,6 +1268,24 @@ void printAudioVars()
 
   cliSerialPrint("normalContext: %u",
               (uint32_t)audioQueue.normalContext.fragment.type);
+
+  cliSerialPrint("stats: buffers: %u, underruns: %u, max wait: %ums, max read: %uus",
+                 audioStats.buffers, audioStats.underruns,
+                 (uint32_t)audioStats.maxQueueWait,
+                 (uint32_t)audioStats.maxDecodeTime);
+  for (int n = 0; n <= AUDIO_BUFFER_COUNT; n++) {
+    cliSerialPrint("fill level %d: %u", n, audioStats.fillLevel[n]);
+  }
+  for (int n = 0; n < AUDIO_STATS_BINS; n++) {
+    // the last bins are unbounded
+    cliSerialPrint("%s %ums: %u wait, %s %uus: %u read",
+                   n < AUDIO_STATS_BINS - 1 ? "<" : ">=",
+                   AUDIO_STATS_QUEUE_WAIT_BASE << (n < AUDIO_STATS_BINS - 1 ? n : n - 1),
+                   audioStats.queueWait[n],
+                   n < AUDIO_STATS_BINS - 1 ? "<" : ">=",
+                   AUDIO_STATS_DECODE_TIME_BASE << (n < AUDIO_STATS_BINS - 1 ? n : n - 1),
+                   audioStats.decodeTime[n]);
+  }
 }
 #endif
 
@@ -1381,12 +1411,57 @@ int cliDisplay(const char ** argv)
   else if (!strcmp(argv[1], "audio")) {
     printAudioVars();
   }
+#endif
+  else if (!strcmp(argv[1], "storage")) {
+    cliSerialPrint("Storage writes: req: %u, w: %u (forced: %u), deferred: %u, max pending: %ums",
+                   storageWriteStats.requests, storageWriteStats.writes,
+                   storageWriteStats.forced, storageWriteStats.deferred,
+                   storageWriteStats.maxPending * 10);
+#if defined(SDCARD_YAML)
+    cliSerialPrint("Model prefetch: p: %u, h: %u, stale: %u, select: %ums (max %ums)",
+                   modelPrefetchStats.prefetches, modelPrefetchStats.hits,
+                   modelPrefetchStats.stale, modelPrefetchStats.lastSelectMs,
+                   modelPrefetchStats.maxSelectMs);
+#endif
+  }
+#if defined(SDCARD)
+  else if (!strcmp(argv[1], "logs")) {
+    cliSerialPrint("Logs writes: extents: %u, syncs: %u, max: %ums",
+                   logsWriteStats.extents, logsWriteStats.syncs,
+                   logsWriteStats.maxLatency);
+    for (int n = 0; n < LOGS_LATENCY_BUCKETS; n++) {
+      cliSerialPrint(n < LOGS_LATENCY_BUCKETS - 1 ? "  < %ums: %u" : "  >= %ums: %u",
+                     1u << min(n, LOGS_LATENCY_BUCKETS - 2), logsWriteStats.latency[n]);
+    }
+#if defined(LOGS_BINARY)
+    cliSerialPrint("Binary logs: records: %u (dropped: %u), samples: %u (dropped: %u), flushes: %u",
+                   logsBinaryStats.records, logsBinaryStats.dropped,
+                   logsBinaryStats.samples, logsBinaryStats.samplesDropped,
+                   logsBinaryStats.flushes);
+#endif
+  }
+#endif
+#if defined(STORAGE_USE_SPI_FLASH) && !defined(DISABLE_FLASH_FTL)
+  else if (!strcmp(argv[1], "ftl")) {
+    FrFTLStats stats;
+    uint16_t erasedPages;
+    if (spiFlashGetFTLStats(&stats, &erasedPages)) {
+      cliSerialPrint("FTL erases: %u (background: %u), static moves: %u, erased pages: %u",
+                     stats.erases, stats.backgroundErases,
+                     stats.wearLevelingMoves, erasedPages);
+    }
+  }
 #endif
 #if defined(DISK_CACHE)
   else if (!strcmp(argv[1], "dc")) {
     DiskCacheStats stats = diskCache.getStats();
     uint32_t hitRate = diskCache.getHitRate();
     cliSerialPrint("Disk Cache stats: w:%u r: %u, h: %u(%0.1f%%), m: %u", stats.noWrites, (stats.noHits + stats.noMisses), stats.noHits, hitRate*0.1f, stats.noMisses);
+    cliSerialPrint("  sequential h: %0.1f%%, random h: %0.1f%%, read ahead: %u (%u used)",
+                   diskCache.getHitRate(DISK_CACHE_SEQUENTIAL)*0.1f,
+                   diskCache.getHitRate(DISK_CACHE_RANDOM)*0.1f,
+                   stats.noReadAheads, stats.noReadAheadHits);
+    cliSerialPrint("  disk writes: %u, flushes: %u", stats.noDiskWrites, stats.noFlushes);
   }
 #endif
   else if (toLongLongInt(argv, 1, &address) > 0) {
@@ -178,7 +178,11 @@ const char * const debugTimerNames[DEBUG_TIMERS_COUNT] = {
   ,"Audio int. "   // debugTimerAudioIterval
   ,"Audio dur. "   // debugTimerAudioDuration
   ," A. consume"   // debugTimerAudioConsume
+  ,"YAML scan  "   // debugTimerYamlScan
+  ,"YAML read  "   // debugTimerYamlRead
+#if defined(SPACEMOUSE)
   ,"SpaceMouse "   // debugTimerSpaceMouseWakeup
+#endif
 };
 
 #endif
@@ -390,6 +390,7 @@ enum DebugTimers {
   debugTimerAudioDuration,
   debugTimerAudioConsume,
   debugTimerYamlScan,
+  debugTimerYamlRead,
 
 #if defined(SPACEMOUSE)
   debugTimerSpacemouseWakeup,
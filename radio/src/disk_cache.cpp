@@ -24,6 +24,10 @@
 
 #include <string.h>
 
+#if defined(DISK_CACHE_WRITEBACK)
+  #include "rtos.h"
+#endif
+
 #if 0  // set to 1 to enable traces
   #include "debug.h"
   #define TRACE_DISK_CACHE(...)   TRACE(__VA_ARGS__)
@@ -44,25 +48,42 @@ class DiskCacheBlock
 {
  public:
   DiskCacheBlock();
+  void setData(uint8_t* data);
+  uint8_t* getData() const;
   bool read(BYTE* buff, DWORD sector, UINT count);
-  DRESULT fill(const diskio_driver_t* drv, BYTE lun, BYTE* buff, DWORD sector,
-               UINT count);
+  void filled(DWORD sector, uint32_t use);
   void free(DWORD sector, UINT count);
   void free();
   bool empty() const;
 
+  uint32_t lastUse;  // for LRU replacement
+  bool readAhead;    // filled ahead of a stream, not read yet
+
  private:
-  uint8_t data[DISK_CACHE_BLOCK_SIZE];
+  uint8_t* data;
   DWORD startSector;
   DWORD endSector;
 };
 
 DiskCacheBlock::DiskCacheBlock():
+  lastUse(0),
+  readAhead(false),
+  data(nullptr),
   startSector(0),
   endSector(0) 
 {
 }
 
+void DiskCacheBlock::setData(uint8_t* data)
+{
+  this->data = data;
+}
+
+uint8_t* DiskCacheBlock::getData() const
+{
+  return data;
+}
+
 bool DiskCacheBlock::read(BYTE * buff, DWORD sector, UINT count)
 {
   if (sector >= startSector && (sector+count) <= endSector) {
@@ -73,18 +94,13 @@ bool DiskCacheBlock::read(BYTE * buff, DWORD sector, UINT count)
   return false;
 }
 
-DRESULT DiskCacheBlock::fill(const diskio_driver_t* drv, BYTE lun, BYTE * buff,
-			     DWORD sector, UINT count)
+void DiskCacheBlock::filled(DWORD sector, uint32_t use)
 {
-  DRESULT res = drv->read(lun, data, sector, DISK_CACHE_BLOCK_SECTORS);
-  if (res != RES_OK) {
-    return res;
-  }
   startSector = sector;
   endSector = sector + DISK_CACHE_BLOCK_SECTORS;
-  memcpy(buff, data, count * BLOCK_SIZE);
-  TRACE_DISK_CACHE("cache %p FILLED from read(%u, %u)", this, (uint32_t)sector, (uint32_t)count);
-  return RES_OK;
+  lastUse = use;
+  readAhead = false;
+  TRACE_DISK_CACHE("cache %p FILLED from %u", this, (uint32_t)sector);
 }
 
 void DiskCacheBlock::free(DWORD sector, UINT count) 
@@ -105,28 +121,64 @@ bool DiskCacheBlock::empty() const
   return (endSector == 0);
 }
 
-DiskCache::DiskCache() : lastBlock(0), blocks(nullptr), diskDrv(nullptr)
+DiskCache::DiskCache() :
+    useCounter(0),
+    blocks(nullptr),
+    blocksData(nullptr),
+    diskDrv(nullptr),
+    sectors(0)
+#if defined(DISK_CACHE_WRITEBACK)
+    ,
+    dirtyData(nullptr),
+    dirtyCount(0),
+    dirtyTime(0)
+#endif
+{
+  memset(&stats, 0, sizeof(stats));
+  memset(streams, 0, sizeof(streams));
+}
+
+DiskCache::~DiskCache()
 {
-  stats.noHits = 0;
-  stats.noMisses = 0;
-  stats.noWrites = 0;
+  delete[] blocks;
+  delete[] blocksData;
+#if defined(DISK_CACHE_WRITEBACK)
+  delete[] dirtyData;
+#endif
 }
 
 void DiskCache::initialize(const diskio_driver_t* drv)
 {
-  blocks = new DiskCacheBlock[DISK_CACHE_BLOCKS_NUM];
+  if (!blocks) {
+    // blocks data is contiguous, so that adjacent blocks
+    // can be filled with a single read
+    blocks = new DiskCacheBlock[DISK_CACHE_BLOCKS_NUM];
+    blocksData = new uint8_t[DISK_CACHE_BLOCKS_NUM * DISK_CACHE_BLOCK_SIZE];
+    for (int n = 0; n < DISK_CACHE_BLOCKS_NUM; ++n) {
+      blocks[n].setData(blocksData + n * DISK_CACHE_BLOCK_SIZE);
+    }
+#if defined(DISK_CACHE_WRITEBACK)
+    dirtyData = new uint8_t[DISK_CACHE_DIRTY_SECTORS * BLOCK_SIZE];
+#endif
+  }
   diskDrv = drv;
 }
 
+// Note: delayed writes are dropped as well, the disk is flushed
+// before being unmounted (see storagePreUnmountHook())
 void DiskCache::clear()
 {
-  lastBlock = 0;
-  stats.noHits = 0;
-  stats.noMisses = 0;
-  stats.noWrites = 0;
+  useCounter = 0;
+  sectors = 0;
+  memset(&stats, 0, sizeof(stats));
+  memset(streams, 0, sizeof(streams));
   for (int n = 0; n < DISK_CACHE_BLOCKS_NUM; ++n) {
     blocks[n].free();
+    blocks[n].lastUse = 0;
   }
+#if defined(DISK_CACHE_WRITEBACK)
+  dirtyCount = 0;
+#endif
 }
 
 uint32_t DiskCache::getSectors(uint8_t lun)
@@ -137,12 +189,86 @@ uint32_t DiskCache::getSectors(uint8_t lun)
   return sectors;
 }
 
+DRESULT DiskCache::diskRead(BYTE lun, BYTE* buff, DWORD sector, UINT count)
+{
+  DRESULT res = diskDrv->read(lun, buff, sector, count);
+#if defined(DISK_CACHE_WRITEBACK)
+  // delayed writes are newer than what the disk holds
+  if (res == RES_OK && dirtyCount > 0) {
+    for (UINT s = 0; s < count; s++) {
+      int n = findDirty(sector + s);
+      if (n >= 0 && dirtySectors[n] == sector + s) {
+        memcpy(buff + s * BLOCK_SIZE, dirtyData + n * BLOCK_SIZE, BLOCK_SIZE);
+      }
+    }
+  }
+#endif
+  return res;
+}
+
+DiskCacheAccess DiskCache::updateStreams(DWORD sector, UINT count)
+{
+  DiskCacheStream* oldest = &streams[0];
+  for (int n = 0; n < DISK_CACHE_STREAMS; ++n) {
+    DiskCacheStream& stream = streams[n];
+    if (stream.nextSector == sector && sector != 0) {
+      stream.nextSector = sector + count;
+      stream.lastUse = useCounter;
+      return DISK_CACHE_SEQUENTIAL;
+    }
+    if (stream.lastUse < oldest->lastUse) {
+      oldest = &stream;
+    }
+  }
+
+  // may be the start of a new stream
+  oldest->nextSector = sector + count;
+  oldest->lastUse = useCounter;
+  return DISK_CACHE_RANDOM;
+}
+
+DiskCacheBlock* DiskCache::leastRecentlyUsed()
+{
+  DiskCacheBlock* lru = &blocks[0];
+  for (int n = 0; n < DISK_CACHE_BLOCKS_NUM; ++n) {
+    if (blocks[n].empty()) {
+      return &blocks[n];
+    }
+    if (blocks[n].lastUse < lru->lastUse) {
+      lru = &blocks[n];
+    }
+  }
+  return lru;
+}
+
+DiskCacheBlock* DiskCache::leastRecentlyUsedPair()
+{
+  // the pair whose most recently used block is the oldest
+  DiskCacheBlock* lru = &blocks[0];
+  uint32_t lruUse = UINT32_MAX;
+  for (int n = 0; n < DISK_CACHE_BLOCKS_NUM - 1; ++n) {
+    uint32_t use = 0;
+    if (!blocks[n].empty() && blocks[n].lastUse > use) use = blocks[n].lastUse;
+    if (!blocks[n + 1].empty() && blocks[n + 1].lastUse > use) use = blocks[n + 1].lastUse;
+    if (use < lruUse) {
+      lru = &blocks[n];
+      lruUse = use;
+    }
+  }
+  return lru;
+}
+
 DRESULT DiskCache::read(BYTE lun, BYTE * buff, DWORD sector, UINT count)
 {
+  TRACE_DISK_CACHE("r %u %u", (uint32_t)sector, (uint32_t)count);
+
+  ++useCounter;
+  DiskCacheAccess access = updateStreams(sector, count);
+
   // if read is bigger than cache block, then read it directly without using cache
   if (count > DISK_CACHE_BLOCK_SECTORS) {
     TRACE_DISK_CACHE("big read(%u, %u)",  (uint32_t)sector, (uint32_t)count);
-    return diskDrv->read(lun, buff, sector, count);
+    return diskRead(lun, buff, sector, count);
   }
   
   // if block + cache block size is beyond the end of the disk,
@@ -150,44 +276,197 @@ DRESULT DiskCache::read(BYTE lun, BYTE * buff, DWORD sector, UINT count)
   if (sector + DISK_CACHE_BLOCK_SECTORS >= getSectors(lun)) {
     TRACE_DISK_CACHE("cache would be beyond end of disk %u (%u)",
 		     (uint32_t)sector, getSectors(lun));
-    return diskDrv->read(lun, buff, sector, count);
+    return diskRead(lun, buff, sector, count);
   }
 
   for (int n = 0; n < DISK_CACHE_BLOCKS_NUM; ++n) {
-    if (blocks[n].read(buff, sector, count)) {
+    DiskCacheBlock& block = blocks[n];
+    if (block.read(buff, sector, count)) {
       ++stats.noHits;
+      ++stats.noAccessHits[access];
+      if (block.readAhead) {
+        ++stats.noReadAheadHits;
+        block.readAhead = false;
+      }
+      block.lastUse = useCounter;
       return RES_OK;
     }
   }
 
   ++stats.noMisses;
+  ++stats.noAccessMisses[access];
 
-  // find free block
-  for (int n = 0; n < DISK_CACHE_BLOCKS_NUM; ++n) {
-    if (blocks[n].empty()) {
-      TRACE_DISK_CACHE("\t\t using free block");
-      return blocks[n].fill(diskDrv, lun, buff, sector, count);
+  // a stream is likely to read the next block as well: both are read
+  // at once, which costs much less than two separate reads
+  if (access == DISK_CACHE_SEQUENTIAL &&
+      sector + 2 * DISK_CACHE_BLOCK_SECTORS < getSectors(lun)) {
+    DiskCacheBlock* block = leastRecentlyUsedPair();
+    DRESULT res = diskRead(lun, block->getData(), sector,
+                           2 * DISK_CACHE_BLOCK_SECTORS);
+    if (res != RES_OK) {
+      block[0].free();
+      block[1].free();
+      return res;
     }
+    block[0].filled(sector, useCounter);
+    block[1].filled(sector + DISK_CACHE_BLOCK_SECTORS, useCounter);
+    block[1].readAhead = true;
+    ++stats.noReadAheads;
+    memcpy(buff, block->getData(), count * BLOCK_SIZE);
+    return RES_OK;
   }
 
-  // use next block (round robin)
-  // TODO: use better strategy to select which used block gets used here
-  if (++lastBlock >= DISK_CACHE_BLOCKS_NUM) {
-    lastBlock = 0;
+  DiskCacheBlock* block = leastRecentlyUsed();
+  DRESULT res = diskRead(lun, block->getData(), sector,
+                         DISK_CACHE_BLOCK_SECTORS);
+  if (res != RES_OK) {
+    block->free();
+    return res;
   }
-  
-  return blocks[lastBlock].fill(diskDrv, lun, buff, sector, count);
+  block->filled(sector, useCounter);
+  memcpy(buff, block->getData(), count * BLOCK_SIZE);
+  return RES_OK;
+}
+
+#if defined(DISK_CACHE_WRITEBACK)
+// returns the index of the first dirty sector >= 'sector'
+int DiskCache::findDirty(DWORD sector) const
+{
+  int lo = 0, hi = dirtyCount;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (dirtySectors[mid] < sector)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo < (int)dirtyCount ? lo : -1;
+}
+
+DRESULT DiskCache::addDirty(BYTE lun, const BYTE* buff, DWORD sector)
+{
+  int n = findDirty(sector);
+  if (n >= 0 && dirtySectors[n] == sector) {
+    memcpy(dirtyData + n * BLOCK_SIZE, buff, BLOCK_SIZE);
+    return RES_OK;
+  }
+
+  if (dirtyCount == DISK_CACHE_DIRTY_SECTORS) {
+    DRESULT res = flush(lun);
+    if (res != RES_OK) return res;
+    n = -1;
+  }
+
+  if (n < 0) n = dirtyCount;
+  memmove(&dirtySectors[n + 1], &dirtySectors[n],
+          (dirtyCount - n) * sizeof(DWORD));
+  memmove(dirtyData + (n + 1) * BLOCK_SIZE, dirtyData + n * BLOCK_SIZE,
+          (dirtyCount - n) * BLOCK_SIZE);
+  dirtySectors[n] = sector;
+  memcpy(dirtyData + n * BLOCK_SIZE, buff, BLOCK_SIZE);
+
+  if (dirtyCount++ == 0) {
+    dirtyTime = RTOS_GET_MS();
+  }
+  return RES_OK;
+}
+
+void DiskCache::removeDirty(DWORD sector, UINT count)
+{
+  int n = findDirty(sector);
+  if (n < 0) return;
+
+  int end = n;
+  while (end < (int)dirtyCount && dirtySectors[end] < sector + count) {
+    end++;
+  }
+  memmove(&dirtySectors[n], &dirtySectors[end],
+          (dirtyCount - end) * sizeof(DWORD));
+  memmove(dirtyData + n * BLOCK_SIZE, dirtyData + end * BLOCK_SIZE,
+          (dirtyCount - end) * BLOCK_SIZE);
+  dirtyCount -= end - n;
+}
+#endif
+
+DRESULT DiskCache::flush(BYTE lun)
+{
+#if defined(DISK_CACHE_WRITEBACK)
+  if (dirtyCount == 0) return RES_OK;
+
+  ++stats.noFlushes;
+
+  // one write per run of adjacent sectors
+  uint32_t start = 0;
+  while (start < dirtyCount) {
+    uint32_t end = start + 1;
+    while (end < dirtyCount &&
+           dirtySectors[end] == dirtySectors[end - 1] + 1) {
+      end++;
+    }
+
+    TRACE_DISK_CACHE("write back(%u, %u)", (uint32_t)dirtySectors[start],
+                     end - start);
+    ++stats.noDiskWrites;
+    DRESULT res = diskDrv->write(lun, dirtyData + start * BLOCK_SIZE,
+                                 dirtySectors[start], end - start);
+    if (res != RES_OK) {
+      // keep what could not be written
+      removeDirty(dirtySectors[0], dirtySectors[start] - dirtySectors[0]);
+      return res;
+    }
+    start = end;
+  }
+
+  dirtyCount = 0;
+#endif
+  return RES_OK;
+}
+
+bool DiskCache::flushDue() const
+{
+#if defined(DISK_CACHE_WRITEBACK)
+  return dirtyCount > 0 &&
+         (uint32_t)(RTOS_GET_MS() - dirtyTime) >= DISK_CACHE_WRITEBACK_MS;
+#else
+  return false;
+#endif
 }
 
 DRESULT DiskCache::write(BYTE lun, const BYTE* buff, DWORD sector, UINT count)
 {
+  TRACE_DISK_CACHE("w %u %u", (uint32_t)sector, (uint32_t)count);
+
   ++stats.noWrites;
   for(int n = 0; n < DISK_CACHE_BLOCKS_NUM; ++n) {
     blocks[n].free(sector, count);
   }
+
+#if defined(DISK_CACHE_WRITEBACK)
+  if (count <= DISK_CACHE_DIRTY_SECTORS / 2) {
+    for (UINT s = 0; s < count; s++) {
+      DRESULT res = addDirty(lun, buff + s * BLOCK_SIZE, sector + s);
+      if (res != RES_OK) return res;
+    }
+    return RES_OK;
+  }
+
+  // large writes go straight to the disk, and supersede delayed ones
+  removeDirty(sector, count);
+#endif
+
+  ++stats.noDiskWrites;
   return diskDrv->write(lun, buff, sector, count);
 }
 
+DRESULT DiskCache::ioctl(BYTE lun, BYTE cmd, void* buff)
+{
+  if (cmd == CTRL_SYNC) {
+    DRESULT res = flush(lun);
+    if (res != RES_OK) return res;
+  }
+  return diskDrv->ioctl(lun, cmd, buff);
+}
+
 const DiskCacheStats & DiskCache::getStats() const 
 { 
   return stats; 
@@ -200,6 +479,13 @@ int DiskCache::getHitRate() const
   return (stats.noHits * 1000) / all;
 }
 
+int DiskCache::getHitRate(DiskCacheAccess access) const
+{
+  uint32_t all = stats.noAccessHits[access] + stats.noAccessMisses[access];
+  if (all == 0) return 0;
+  return (stats.noAccessHits[access] * 1000) / all;
+}
+
 DRESULT disk_cache_read(BYTE drv, BYTE * buff, DWORD sector, UINT count)
 {
   return diskCache.read(drv, buff, sector, count);
@@ -210,3 +496,7 @@ DRESULT disk_cache_write(BYTE drv, const BYTE * buff, DWORD sector, UINT count)
   return diskCache.write(drv, buff, sector, count);
 }
 
+DRESULT disk_cache_ioctl(BYTE drv, BYTE cmd, void * buff)
+{
+  return diskCache.ioctl(drv, cmd, buff);
+}
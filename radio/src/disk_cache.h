@@ -26,43 +26,96 @@
 // tunable parameters
 #define DISK_CACHE_BLOCKS_NUM      32   // no cache blocks
 #define DISK_CACHE_BLOCK_SECTORS   16   // no sectors
+#define DISK_CACHE_STREAMS         4    // no sequential streams tracked
+
+#if defined(DISK_CACHE_WRITEBACK)
+// writes are delayed and coalesced into one per run of adjacent sectors
+#define DISK_CACHE_DIRTY_SECTORS   32   // no sectors
+#define DISK_CACHE_WRITEBACK_MS    1000 // longest delay
+#endif
+
+// reads continuing a previous one (files being streamed: sounds, logs,
+// bitmaps...) are accounted apart from the others (FAT, directories...)
+enum DiskCacheAccess
+{
+  DISK_CACHE_RANDOM,
+  DISK_CACHE_SEQUENTIAL,
+  DISK_CACHE_ACCESS_COUNT
+};
 
 struct DiskCacheStats
 {
   uint32_t noHits;
   uint32_t noMisses;
   uint32_t noWrites;
+  uint32_t noReadAheads;     // blocks read ahead of a sequential stream
+  uint32_t noReadAheadHits;  // of which were then read
+  uint32_t noAccessHits[DISK_CACHE_ACCESS_COUNT];
+  uint32_t noAccessMisses[DISK_CACHE_ACCESS_COUNT];
+  uint32_t noDiskWrites;     // writes sent to the disk
+  uint32_t noFlushes;
 };
 
 class DiskCacheBlock;
 
+struct DiskCacheStream
+{
+  DWORD nextSector;
+  uint32_t lastUse;
+};
+
 class DiskCache
 {
  public:
   DiskCache();
+  ~DiskCache();
 
   void initialize(const diskio_driver_t* drv);
   void clear();
 
   DRESULT read(BYTE drv, BYTE* buff, DWORD sector, UINT count);
   DRESULT write(BYTE drv, const BYTE* buff, DWORD sector, UINT count);
+  DRESULT ioctl(BYTE drv, BYTE cmd, void* buff);
+
+  // write back the delayed writes
+  DRESULT flush(BYTE drv);
+  // delayed writes are pending for too long
+  bool flushDue() const;
 
   const DiskCacheStats& getStats() const;
   int getHitRate() const;
+  int getHitRate(DiskCacheAccess access) const;
 
  private:
   DiskCacheStats stats;
-  uint32_t lastBlock;
+  uint32_t useCounter;
   DiskCacheBlock* blocks;
+  uint8_t* blocksData;
+  DiskCacheStream streams[DISK_CACHE_STREAMS];
   const diskio_driver_t* diskDrv;
   uint32_t sectors;
 
+#if defined(DISK_CACHE_WRITEBACK)
+  // sorted by sector, data is in the same order
+  DWORD dirtySectors[DISK_CACHE_DIRTY_SECTORS];
+  uint8_t* dirtyData;
+  uint32_t dirtyCount;
+  uint32_t dirtyTime;
+
+  int findDirty(DWORD sector) const;
+  DRESULT addDirty(BYTE lun, const BYTE* buff, DWORD sector);
+  void removeDirty(DWORD sector, UINT count);
+#endif
+
   uint32_t getSectors(uint8_t lun);
+  DRESULT diskRead(BYTE lun, BYTE* buff, DWORD sector, UINT count);
+  DiskCacheAccess updateStreams(DWORD sector, UINT count);
+  DiskCacheBlock* leastRecentlyUsed();
+  DiskCacheBlock* leastRecentlyUsedPair();
 };
 
 extern DiskCache diskCache;
 
 DRESULT disk_cache_read(BYTE drv, BYTE* buff, DWORD sector, UINT count);
 DRESULT disk_cache_write(BYTE drv, const BYTE* buff, DWORD sector, UINT count);
-
-
+DRESULT disk_cache_ioctl(BYTE drv, BYTE cmd, void* buff);
@@ -73,10 +73,21 @@
 // Will cap the buffer size to this when exceeded
 #define MAX_BUFFER_SIZE               64
 
+// Pages released until the next MTT is programmed: the ones of a sync
+// and as many trimmed ones
+#define RELEASED_PAGES_SIZE(ftl)       (2 * (ftl)->pageBufferSize)
+
 // Reserve pages to minimize the erase cycles when the FS is full,
 // should be at least 2 times of BUFFER_SIZE_MULTIPLIER
 #define RESERVED_PAGES_MULTIPLIER      16
 
+// A static page is moved every this many erases, so that the pages
+// it holds are worn as well
+#define WEAR_LEVELING_INTERVAL         64
+
+// Unknown page states resolved per garbage collection step
+#define GC_RESOLVE_PAGES               16
+
 #define LOCKED   1
 #define UNLOCKED 0
 
@@ -541,6 +552,46 @@ static uint16_t allocatePhysicalPage(FrFTL* ftl)
   return physicalPageNo;
 }
 
+static bool erasePhysicalPage(FrFTL* ftl, uint16_t physicalPageNo)
+{
+  const FrFTLOps* cb = ftl->callbacks;
+  if (!cb->flashErase(physicalPageNo * PAGE_SIZE)) {
+    return false;
+  }
+  ftl->stats.erases++;
+  if (ftl->erasesSinceWearLeveling < 0xffff) {
+    ftl->erasesSinceWearLeveling++;
+  }
+  return true;
+}
+
+// The pages replaced are still referenced by the MTT in flash until
+// the new one is programmed, they cannot be erased before
+static void releasePhysicalPage(FrFTL* ftl, uint16_t physicalPageNo)
+{
+  if (ftl->releasedPageCount < RELEASED_PAGES_SIZE(ftl)) {
+    ftl->releasedPages[ftl->releasedPageCount++] = physicalPageNo;
+  }
+  // Otherwise the page is left used, it is only reclaimed at the
+  // next mount, as a page no longer referenced by the TT
+}
+
+// Trims release pages outside of a sync: they are synced before they
+// fill half of the released pages, a sync releasing at most one page
+// per buffer
+static bool hasReleasedPagesSpace(FrFTL* ftl)
+{
+  return ftl->releasedPageCount < ftl->pageBufferSize;
+}
+
+static void freeReleasedPages(FrFTL* ftl)
+{
+  for (uint16_t i = 0; i < ftl->releasedPageCount; i++) {
+    setPhysicalPageState(ftl, ftl->releasedPages[i], ERASE_REQUIRED);
+  }
+  ftl->releasedPageCount = 0;
+}
+
 static bool programPage(FrFTL* ftl, PageBuffer* buffer, bool doErase)
 {
   const FrFTLOps* cb = ftl->callbacks;
@@ -548,7 +599,7 @@ static bool programPage(FrFTL* ftl, PageBuffer* buffer, bool doErase)
         
   if (doErase && getPhysicalPageState(ftl, buffer->physicalPageNo) != ERASED) {
     // Do erase on the fly
-    if (!cb->flashErase(pageAddr)) {
+    if (!erasePhysicalPage(ftl, buffer->physicalPageNo)) {
       return false;
     }
   }
@@ -558,19 +609,18 @@ static bool programPage(FrFTL* ftl, PageBuffer* buffer, bool doErase)
   }
 
   // Sector by sector programming:
-  // As flash requires 256 bytes per program command, it will be more efficient to program by sector
-  uint8_t* dataPtr = buffer->page.data;
-  for (uint8_t i = 0; i < SECTORS_PER_PAGE; i++)
+  // As flash requires 256 bytes per program command, it will be more efficient to program by sector.
+  // The last sector first, so that TT headers are only valid once the whole page is programmed
+  for (int8_t i = SECTORS_PER_PAGE - 1; i >= 0; i--)
   {
     uint8_t sectMask = 1 << i;
     if ((buffer->sectorProgramRequired & sectMask) != 0) {
-      if (!cb->flashProgram(pageAddr, dataPtr, SECTOR_SIZE))
+      if (!cb->flashProgram(pageAddr + i * SECTOR_SIZE,
+                            buffer->page.data + i * SECTOR_SIZE, SECTOR_SIZE))
       {
         return false;
       }
     }
-    pageAddr += SECTOR_SIZE;
-    dataPtr += SECTOR_SIZE;
   }
 
   return true;
@@ -603,12 +653,16 @@ static bool programPageInBuffer(FrFTL* ftl, PageBuffer* buffer)
     case RELOCATE_ERASE_PROGRAM:
       // Reprogram
       oldPhysicalPageNo = buffer->physicalPageNo;
-      setPhysicalPageState(ftl, oldPhysicalPageNo, ERASE_REQUIRED);
       removePageFromHashTable(ftl, oldPhysicalPageNo);
       buffer->physicalPageNo = allocatePhysicalPage(ftl);
       if (buffer->physicalPageNo == 0xffff) {
+        buffer->physicalPageNo = oldPhysicalPageNo;
+        addPageToHashTable(ftl, buffer);
         return false;
       }
+      // The old MTT as well: it is the committed one until the new MTT
+      // is programmed, which may fail
+      releasePhysicalPage(ftl, oldPhysicalPageNo);
 
       if (buffer->logicalPageNo < ftl->ttPageCount) {
         if (buffer->logicalPageNo == 0) {
@@ -730,6 +784,7 @@ bool ftlSync(FrFTL* ftl)
     mttBuffer->lock = UNLOCKED;
     mttBuffer->pMode = NONE;
   }
+  freeReleasedPages(ftl);
 
   return true;
 }
@@ -827,7 +882,6 @@ bool ftlWrite(FrFTL* ftl, uint32_t startSectorNo, uint32_t noOfSectors,
 
 bool ftlRead(FrFTL* ftl, uint32_t sectorNo, uint8_t* buffer)
 {
-  //  doGC(ftl, ftl->ttPageCount, 1);
   if (sectorNo >= ftl->usableSectorCount) {
     return false;
   }
@@ -862,7 +916,7 @@ bool ftlTrim(FrFTL* ftl, uint32_t startSectorNo, uint32_t noOfSectors)
   while (noOfSectors > 0) {
     // Max no. of sectors need to be rewritten is 3,
     // need to ensure has enough free buffers
-    if (!hasFreeBuffers(ftl, 3)) {
+    if (!hasFreeBuffers(ftl, 3) || !hasReleasedPagesSpace(ftl)) {
       // Flush the buffers first if free space is not found
       if (!ftlSync(ftl)) {
         return false;
@@ -890,7 +944,7 @@ bool ftlTrim(FrFTL* ftl, uint32_t startSectorNo, uint32_t noOfSectors)
         pageInfo.sectStatus |= sectMask;
         if (pageInfo.sectStatus == 0xff) {
           // Free whole page
-          setPhysicalPageState(ftl, pageInfo.physicalPageNo, ERASE_REQUIRED);
+          releasePhysicalPage(ftl, pageInfo.physicalPageNo);
           removePageFromHashTable(ftl, pageInfo.physicalPageNo);
           pageInfo.physicalPageNo = 0xffff;     // Invalidate page info
           dataBuffer->physicalPageNo = 0xffff;  // Invalidate buffer
@@ -923,12 +977,145 @@ bool ftlTrim(FrFTL* ftl, uint32_t startSectorNo, uint32_t noOfSectors)
   return true;
 }
 
-static void initPageBuffer(FrFTL* ftl)
+static bool hasLockedBuffers(FrFTL* ftl)
+{
+  PageBuffer* pageBuffer = ((PageBuffer*)(ftl->pageBuffer));
+  for (uint16_t i = 0; i < ftl->pageBufferSize; i++) {
+    if (pageBuffer[i].lock == LOCKED) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Reverse lookup in the TT pages, TT pages themselves are not returned
+static uint16_t findDataLogicalPageNo(FrFTL* ftl, uint16_t physicalPageNo)
+{
+  for (uint16_t ttPageNo = 0; ttPageNo < ftl->ttPageCount; ttPageNo++) {
+    PageInfo ttPageInfo;
+    if (!readPageInfo(ftl, &ttPageInfo, ttPageNo)) {
+      return 0xffff;
+    }
+    PageBuffer* ttBuffer =
+        loadPhysicalPageInBuffer(ftl, ttPageNo, ttPageInfo.physicalPageNo);
+    if (!ttBuffer) {
+      return 0xffff;
+    }
+    for (uint16_t i = 0; i < TT_RECORDS_PER_PAGE; i++) {
+      if (ttBuffer->page.tt.physicalPageNo[i] == physicalPageNo) {
+        uint32_t logicalPageNo = ttPageNo * TT_RECORDS_PER_PAGE + i;
+        return logicalPageNo < ftl->ttPageCount ? 0xffff : logicalPageNo;
+      }
+    }
+  }
+  return 0xffff;
+}
+
+// Static data would keep the pages holding it out of the erase cycles:
+// the pages in use are moved in turn to the write frontier
+static bool moveStaticPage(FrFTL* ftl)
+{
+  // Only whole syncs are done in background
+  if (hasLockedBuffers(ftl)) {
+    return false;
+  }
+
+  for (uint16_t i = 0; i < ftl->physicalPageCount; i++) {
+    uint16_t physicalPageNo = ftl->wearLevelingPageNo++;
+    if (ftl->wearLevelingPageNo >= ftl->physicalPageCount) {
+      ftl->wearLevelingPageNo = 0;
+    }
+    if (getPhysicalPageState(ftl, physicalPageNo) != USED) {
+      continue;
+    }
+
+    uint16_t logicalPageNo = findDataLogicalPageNo(ftl, physicalPageNo);
+    if (logicalPageNo == 0xffff) {
+      continue;
+    }
+
+    PageInfo pageInfo;
+    if (!readPageInfo(ftl, &pageInfo, logicalPageNo)) {
+      return false;
+    }
+    PageBuffer* dataBuffer =
+        loadPhysicalPageInBuffer(ftl, logicalPageNo, pageInfo.physicalPageNo);
+    if (!dataBuffer) {
+      return false;
+    }
+
+    // Same as a rewrite of the page
+    dataBuffer->lock = LOCKED;
+    dataBuffer->pMode = RELOCATE_ERASE_PROGRAM;
+    dataBuffer->sectorProgramRequired = ~pageInfo.sectStatus;
+    if (!lockTTPages(ftl, logicalPageNo)) {
+      return false;
+    }
+
+    ftl->erasesSinceWearLeveling = 0;
+    ftl->stats.wearLevelingMoves++;
+    return ftlSync(ftl);
+  }
+
+  // Nothing to move
+  ftl->erasesSinceWearLeveling = 0;
+  return false;
+}
+
+bool ftlGarbageCollect(FrFTL* ftl)
+{
+  // Resolve the pages left unknown at startup
+  if (!ftl->physicalPageStateResolved) {
+    resolveUnknownState(ftl, GC_RESOLVE_PAGES);
+    return true;
+  }
+
+  // Erase the freed pages, in the order they will be allocated. The pages
+  // released since the last sync are still used: they are referenced by
+  // the committed MTT until the new one is programmed
+  uint16_t physicalPageNo = ftl->writeFrontier;
+  for (uint16_t i = 0; i < ftl->physicalPageCount; i++) {
+    if (getPhysicalPageState(ftl, physicalPageNo) == ERASE_REQUIRED) {
+      if (!erasePhysicalPage(ftl, physicalPageNo)) {
+        return false;
+      }
+      setPhysicalPageState(ftl, physicalPageNo, ERASED);
+      ftl->stats.backgroundErases++;
+      return true;
+    }
+    physicalPageNo++;
+    if (physicalPageNo >= ftl->physicalPageCount) {
+      physicalPageNo = 0;
+    }
+  }
+
+  if (ftl->erasesSinceWearLeveling >= WEAR_LEVELING_INTERVAL) {
+    return moveStaticPage(ftl);
+  }
+
+  return false;
+}
+
+uint16_t ftlGetErasedPageCount(FrFTL* ftl)
+{
+  uint16_t count = 0;
+  for (uint16_t i = 0; i < ftl->physicalPageCount; i++) {
+    if (getPhysicalPageState(ftl, i) == ERASED) {
+      count++;
+    }
+  }
+  return count;
+}
+
+static bool initPageBuffer(FrFTL* ftl)
 {
   // Init page buffer
   uint32_t bufferSize = sizeof(PageBuffer) * ftl->pageBufferSize;
   ftl->memoryUsed += bufferSize;
   ftl->pageBuffer = malloc(bufferSize);
+  if (!ftl->pageBuffer) {
+    return false;
+  }
   ftl->bufferHead = ftl->pageBuffer;
 
   for (uint16_t i = 0; i < ftl->pageBufferSize; i++) {
@@ -957,7 +1144,17 @@ static void initPageBuffer(FrFTL* ftl)
   bufferSize = sizeof(PageBuffer*) * ftl->pageBufferSize;
   ftl->memoryUsed += bufferSize;
   ftl->hashTable = malloc(bufferSize);
+  if (!ftl->hashTable) {
+    return false;
+  }
   memset(ftl->hashTable, 0, bufferSize);
+
+  // Init released pages
+  bufferSize = sizeof(uint16_t) * RELEASED_PAGES_SIZE(ftl);
+  ftl->memoryUsed += bufferSize;
+  ftl->releasedPages = (uint16_t*)malloc(bufferSize);
+  ftl->releasedPageCount = 0;
+  return ftl->releasedPages != nullptr;
 }
 
 static void initTransTablePage(TransTable* tt, uint32_t logicalPageNo)
@@ -989,9 +1186,10 @@ void createFTL(FrFTL* ftl)
 
   uint32_t addr = PAGE_SIZE;
   const FrFTLOps* cb = ftl->callbacks;
-  do {
+  // STT pages, none when the MTT covers the whole flash
+  while (i < ftl->ttPageCount) {
     if (getPhysicalPageState(ftl, i) != ERASED) {
-      cb->flashErase(addr);
+      erasePhysicalPage(ftl, i);
     }
     cb->flashProgram(addr, (const uint8_t*)&tt, PAGE_SIZE);
     setPhysicalPageState(ftl, i, USED);
@@ -999,8 +1197,7 @@ void createFTL(FrFTL* ftl)
     i += 1;
     addr += PAGE_SIZE;
     updateTransTablePage(&tt, i);
-    
-  } while(i < ftl->ttPageCount);
+  }
 
   i = 0;
   initTransTablePage(&tt, i);
@@ -1010,7 +1207,7 @@ void createFTL(FrFTL* ftl)
   } while(++i < ftl->ttPageCount);
 
   if (getPhysicalPageState(ftl, 0) != ERASED) {
-    cb->flashErase(0);
+    erasePhysicalPage(ftl, 0);
   }
 
   cb->flashProgram(0, (const uint8_t*)&tt, PAGE_SIZE);
@@ -1131,13 +1328,19 @@ bool ftlInit(FrFTL* ftl, const FrFTLOps* cb, uint16_t flashSizeInMB)
   uint32_t stateSize =
       ftl->physicalPageCount / 16 + (ftl->physicalPageCount % 16 > 0 ? 1 : 0);
   ftl->physicalPageState = (uint32_t*)calloc(stateSize, sizeof(uint32_t));
+  if (!ftl->physicalPageState) {
+    return false;
+  }
   ftl->physicalPageStateResolved = false;
   ftl->memoryUsed += stateSize * sizeof(uint32_t);
   ftl->pageBufferSize = ftl->ttPageCount * BUFFER_SIZE_MULTIPLIER;
   if (ftl->pageBufferSize > MAX_BUFFER_SIZE) {
     ftl->pageBufferSize = MAX_BUFFER_SIZE;
   }
-  initPageBuffer(ftl);
+  if (!initPageBuffer(ftl)) {
+    ftlDeInit(ftl);
+    return false;
+  }
 
   if (!loadFTL(ftl)) {
     // Need reset physical page state before create
@@ -1152,4 +1355,5 @@ void ftlDeInit(FrFTL* ftl)
   free(ftl->pageBuffer);
   free(ftl->physicalPageState);
   free(ftl->hashTable);
+  free(ftl->releasedPages);
 }
@@ -51,6 +51,12 @@ typedef struct {
   bool (*isFlashErased)(uint32_t addr);
 } FrFTLOps;
 
+typedef struct {
+  uint32_t erases;             // Since init
+  uint32_t backgroundErases;   // Done ahead by ftlGarbageCollect()
+  uint32_t wearLevelingMoves;  // Static pages moved
+} FrFTLStats;
+
 typedef struct {
   const FrFTLOps* callbacks;
   uint32_t mttPhysicalPageNo;
@@ -65,6 +71,11 @@ typedef struct {
   void* bufferHead;  // LRU most used
   void* bufferTail;  // LRU least used
   void* hashTable;   // Fast cache lookup
+  uint16_t* releasedPages;  // Freed, until the MTT is programmed
+  uint16_t releasedPageCount;
+  uint16_t wearLevelingPageNo;       // Next page considered for a move
+  uint16_t erasesSinceWearLeveling;
+  FrFTLStats stats;
   uint32_t memoryUsed;
 } FrFTL;
 
@@ -77,6 +88,13 @@ bool ftlRead(FrFTL* ftl, uint32_t sectorNo, uint8_t* buffer);
 bool ftlTrim(FrFTL* ftl, uint32_t startSectorNo, uint32_t noOfSectors);
 bool ftlSync(FrFTL* ftl);
 
+// Background work: erases a freed page or moves a static one, returns
+// false when there is nothing left to do (or on error)
+bool ftlGarbageCollect(FrFTL* ftl);
+
+// Pages which can be programmed without being erased first
+uint16_t ftlGetErasedPageCount(FrFTL* ftl);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
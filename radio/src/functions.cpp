@@ -78,23 +78,23 @@ PLAY_FUNCTION(playValue, source_t idx)
         }
       }
     }
-    PLAY_NUMBER(val, telemetrySensor.unit == UNIT_CELLS ? UNIT_VOLTS : telemetrySensor.unit, attr);
+    playNumber(val, telemetrySensor.unit == UNIT_CELLS ? UNIT_VOLTS : telemetrySensor.unit, attr, id, fragmentVolume);
   }
   else if (idx >= MIXSRC_FIRST_TIMER && idx <= MIXSRC_LAST_TIMER) {
     int flag = 0;
     if (val > LONG_TIMER_DURATION || -val > LONG_TIMER_DURATION) {
       flag = PLAY_LONG_TIMER;
     }
-    PLAY_DURATION(val, flag);
+    playDuration(val, flag, id, fragmentVolume);
   } else if (idx == MIXSRC_TX_TIME) {
-    PLAY_DURATION(val * 60, PLAY_TIME);
+    playDuration(val * 60, PLAY_TIME, id, fragmentVolume);
   } else if (idx == MIXSRC_TX_VOLTAGE) {
-    PLAY_NUMBER(val, UNIT_VOLTS, PREC1);
+    playNumber(val, UNIT_VOLTS, PREC1, id, fragmentVolume);
   } else {
     if (idx <= MIXSRC_LAST_CH) {
       val = calcRESXto100(val);
     }
-    PLAY_NUMBER(val, 0, 0);
+    playNumber(val, 0, 0, id, fragmentVolume);
   }
 }
 
@@ -379,6 +379,9 @@ void evalFunctions(const CustomFunctionData * functions, CustomFunctionsContext
               newActiveFunctions |= (1u << FUNCTION_LOGS);
               logDelay100ms = CFN_PARAM(
                   cfn);  // logging period is 0..25.5s in 100ms increments
+#if defined(LOGS_BINARY)
+              logFastRate = CFN_LOGS_FAST_RATE(cfn);
+#endif
             }
             break;
 #endif
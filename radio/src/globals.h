@@ -50,6 +50,7 @@ extern uint8_t trimsCheckTimer;
 extern uint8_t trimsDisplayTimer;
 extern uint8_t trimsDisplayMask;
 extern uint32_t maxMixerDuration;
+extern uint32_t lastMixerDuration;
 
 extern uint8_t requiredSpeakerVolume;
 extern uint8_t requiredBacklightBright;
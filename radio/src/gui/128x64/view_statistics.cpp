@@ -214,14 +214,49 @@ void menuStatisticsDebug(event_t event)
   lcdInvertLastLine();
 }
 
+// one 2 pixels wide bar per bin, the highest bin being FH-2 pixels high,
+// on the right of the line
+static void drawAudioHistogram(coord_t y, const uint32_t * bins, uint8_t count)
+{
+  coord_t x = LCD_W - 3 * count;
+  uint32_t highest = 1;
+  for (uint8_t i = 0; i < count; i++) {
+    highest = max(highest, bins[i]);
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    coord_t h = bins[i] ? 1 + (uint64_t)bins[i] * (FH - 3) / highest : 0;
+    lcdDrawSolidFilledRect(x + 3 * i, y + FH - 1 - h, 2, h);
+  }
+}
+
+static void drawAudioStats(coord_t y)
+{
+  lcdDrawTextAlignedLeft(y, "Underruns");
+  lcdDrawNumber(MENU_DEBUG_COL1_OFS, y, audioStats.underruns, LEFT);
+  drawAudioHistogram(y, audioStats.fillLevel, DIM(audioStats.fillLevel));
+  y += FH;
+
+  lcdDrawTextAlignedLeft(y, "Queue wait");
+  lcdDrawNumber(MENU_DEBUG_COL1_OFS, y, audioStats.maxQueueWait, LEFT);
+  lcdDrawText(lcdLastRightPos, y+1, "ms", SMLSIZE);
+  drawAudioHistogram(y, audioStats.queueWait, AUDIO_STATS_BINS);
+  y += FH;
+
+  lcdDrawTextAlignedLeft(y, "Read time");
+  lcdDrawNumber(MENU_DEBUG_COL1_OFS, y, audioStats.maxDecodeTime, LEFT);
+  lcdDrawText(lcdLastRightPos, y+1, "us", SMLSIZE);
+  drawAudioHistogram(y, audioStats.decodeTime, AUDIO_STATS_BINS);
+}
+
 void menuStatisticsDebug2(event_t event)
 {
   title(STR_MENUDEBUG);
 
   switch(event) {
-    // case EVT_KEY_FIRST(KEY_ENTER):
-    //   telemetryErrors  = 0;
-    //   break;
+    case EVT_KEY_FIRST(KEY_ENTER):
+      // telemetryErrors  = 0;
+      audioStats.reset();
+      break;
 
     case EVT_KEY_FIRST(KEY_UP):
 #if defined(KEYS_GPIO_REG_PAGEDN)
@@ -259,6 +294,8 @@ void menuStatisticsDebug2(event_t event)
   y += FH;
 #endif
 
+  drawAudioStats(y);
+
   lcdDrawText(LCD_W/2, 7*FH+1, STR_MENUTORESET, CENTERED);
   lcdInvertLastLine();
 }
@@ -435,6 +435,16 @@ void menuSpecialFunctions(event_t event, CustomFunctionData * functions, CustomF
               if (active) CFN_PLAY_REPEAT(cfn) = checkIncDec(event, CFN_PLAY_REPEAT(cfn)==CFN_PLAY_REPEAT_NOSTART?-1:CFN_PLAY_REPEAT(cfn), -1, 60/CFN_PLAY_REPEAT_MUL, eeFlags);
             }
           }
+#if defined(LOGS_BINARY)
+          else if (func == FUNC_LOGS) {
+            // sticks and channels sampling rate (Hz), '-' logs them with the sensors
+            if (CFN_LOGS_FAST_RATE(cfn) == 0)
+              lcdDrawChar(MODEL_SPECIAL_FUNC_4TH_COLUMN+2, y, '-', attr);
+            else
+              lcdDrawNumber(MODEL_SPECIAL_FUNC_4TH_COLUMN+2+FW, y, CFN_LOGS_FAST_RATE(cfn), attr|RIGHT);
+            if (active) CFN_LOGS_FAST_RATE(cfn) = checkIncDec(event, CFN_LOGS_FAST_RATE(cfn), 0, SD_LOGS_FAST_RATE_MAX, eeFlags);
+          }
+#endif
           else if (attr) {
             repeatLastCursorMove(event);
           }
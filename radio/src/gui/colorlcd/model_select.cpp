@@ -33,6 +33,7 @@
 #include "model_templates.h"
 #include "opentx.h"
 #include "standalone_lua.h"
+#include "storage/sdcard_yaml.h"
 #include "view_channels.h"
 
 // bitmaps for toolbar
@@ -63,6 +64,9 @@ constexpr coord_t MODEL_SELECT_CELL_HEIGHT = 92;
 constexpr int BUTTONS_HEIGHT = 30;
 constexpr int MODEL_CELLS_PER_LINE = 2;
 
+// a model is read ahead once it kept the focus that long
+constexpr tmr10ms_t MODEL_PREFETCH_DELAY_10MS = 30;
+
 #if LCD_W > LCD_H  // Landscape
 constexpr int LABELS_WIDTH = 132;
 constexpr int LAY_MARGIN = 5;
@@ -374,6 +378,35 @@ ModelsPageBody::ModelsPageBody(Window *parent, const rect_t &rect) :
   padRow(MODEL_CELL_PADDING);
 }
 
+ModelsPageBody::~ModelsPageBody()
+{
+  releasePrefetchedModel();
+}
+
+void ModelsPageBody::checkEvents()
+{
+  FormWindow::checkEvents();
+
+  // moving the focus cancels any pending prefetch
+  if (focusedModel != prefetchModel) {
+    prefetchModel = focusedModel;
+    prefetchTime = getTicks();
+    prefetched = false;
+    return;
+  }
+
+  if (prefetched || !prefetchModel ||
+      prefetchModel == modelslist.getCurrentModel() ||
+      (tmr10ms_t)(getTicks() - prefetchTime) < MODEL_PREFETCH_DELAY_10MS)
+    return;
+
+  prefetched = true;
+  const char *error = prefetchModelYaml(prefetchModel->modelFilename);
+  if (error) {
+    TRACE("prefetch %s error=%s", prefetchModel->modelFilename, error);
+  }
+}
+
 void ModelsPageBody::selectModel(ModelCell *model)
 {
   // Don't need to check connection to receiver if re-selecting the active model
@@ -401,6 +434,8 @@ void ModelsPageBody::selectModel(ModelCell *model)
 
   // Skip reloading model if re-selecting the active model
   if (model != modelslist.getCurrentModel()) {
+    uint32_t startMs = RTOS_GET_MS();
+
     // store changes (if any) and load selected model
     storageFlushCurrentModel();
     storageCheck(true);
@@ -412,6 +447,12 @@ void ModelsPageBody::selectModel(ModelCell *model)
 
     storageDirty(EE_GENERAL);
     storageCheck(true);
+
+    uint32_t selectMs = RTOS_GET_MS() - startMs;
+    modelPrefetchStats.lastSelectMs = selectMs;
+    if (selectMs > modelPrefetchStats.maxSelectMs)
+      modelPrefetchStats.maxSelectMs = selectMs;
+    TRACE("model selected in %u ms", selectMs);
   }
 }
 
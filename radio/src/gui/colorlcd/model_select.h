@@ -36,8 +36,10 @@ class ModelsPageBody : public FormWindow
 {
  public:
   ModelsPageBody(Window *parent, const rect_t &rect);
+  ~ModelsPageBody() override;
 
   void update();
+  void checkEvents() override;
 
   void setLabels(LabelsVector labels)
   {
@@ -65,6 +67,11 @@ class ModelsPageBody : public FormWindow
   ModelCell *focusedModel = nullptr;
   std::function<void()> refreshLabels = nullptr;
 
+  // focused model, read ahead once it kept the focus for a while
+  ModelCell *prefetchModel = nullptr;
+  tmr10ms_t prefetchTime = 0;
+  bool prefetched = false;
+
   void openMenu();
   void selectModel(ModelCell *model);
   void duplicateModel(ModelCell *model);
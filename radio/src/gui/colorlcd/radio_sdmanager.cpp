@@ -101,6 +101,7 @@ class FileNameEditWindow : public Page
       }
       changedName[totalSize + extLength] = '\0';
       f_rename((const TCHAR *)name.c_str(), (const TCHAR *)changedName);
+      audioFileChanged(changedName);
     });
   };
 };
@@ -515,6 +516,7 @@ void RadioSdManagerPage::fileAction(const char* path, const char* name,
         }
         sdCopyFile(clipboard.data.sd.filename, clipboard.data.sd.directory,
                    destNamePtr, lfn);
+        audioFileChanged(lfn);
         clipboard.type = CLIPBOARD_TYPE_NONE;
 
         browser->refresh();
@@ -526,6 +528,7 @@ void RadioSdManagerPage::fileAction(const char* path, const char* name,
     });
     menu->addLine(STR_DELETE_FILE, [=]() {
       f_unlink(fullpath);
+      audioFileChanged(fullpath);
       browser->refresh();
     });
   }
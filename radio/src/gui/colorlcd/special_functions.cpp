@@ -243,6 +243,14 @@ class SpecialFunctionEditPage : public Page
             [=](int32_t value) {
               return formatNumberAsString(CFN_PARAM(cfn), PREC1, 0, nullptr, "s");
             });
+#if defined(LOGS_BINARY)
+        line = specialFunctionOneWindow->newLine(&grid);
+        new StaticText(line, rect_t{}, STR_LOGS_FAST_RATE, 0, COLOR_THEME_PRIMARY1);
+        auto rate = new NumberEdit(line, rect_t{}, 0, SD_LOGS_FAST_RATE_MAX,
+                                   GET_SET_DEFAULT(CFN_LOGS_FAST_RATE(cfn)));
+        rate->setZeroText("---");                         // sticks and channels logged with sensors
+        rate->setSuffix("Hz");
+#endif
         break;
       }
 
@@ -636,6 +644,10 @@ class SpecialFunctionButton : public Button
 
       case FUNC_LOGS:
         strcat(s, formatNumberAsString(CFN_PARAM(cfn), PREC1, 0, nullptr, "s").c_str());
+#if defined(LOGS_BINARY)
+        if (CFN_LOGS_FAST_RATE(cfn))
+          sprintf(s+strlen(s), " / %s", formatNumberAsString(CFN_LOGS_FAST_RATE(cfn), 0, 0, nullptr, "Hz").c_str());
+#endif
         break;
 
       case FUNC_ADJUST_GVAR:
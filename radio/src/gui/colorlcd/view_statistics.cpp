@@ -342,6 +342,29 @@ void DebugViewPage::build(FormWindow* window)
       [] { return audioStack.available(); }, COLOR_THEME_PRIMARY1,
       STR_STACK_AUDIO, nullptr);
 
+  line = form->newLine(&grid);
+  line->padAll(2);
+
+  // Audio data
+  new StaticText(line, rect_t{}, "Audio", 0, COLOR_THEME_PRIMARY1);
+#if LCD_H > LCD_W
+  line = form->newLine(&grid2);
+  line->padAll(0);
+  line->padLeft(10);
+#endif
+  new DebugInfoNumber<uint32_t>(
+      line, rect_t{0, 0, DBG_B_WIDTH, DBG_B_HEIGHT},
+      [] { return audioStats.underruns; }, COLOR_THEME_PRIMARY1,
+      "Underruns: ", nullptr);
+  new DebugInfoNumber<uint16_t>(
+      line, rect_t{0, 0, DBG_B_WIDTH, DBG_B_HEIGHT},
+      [] { return audioStats.maxQueueWait; }, COLOR_THEME_PRIMARY1,
+      "Wait(ms): ", nullptr);
+  new DebugInfoNumber<uint16_t>(
+      line, rect_t{0, 0, DBG_B_WIDTH, DBG_B_HEIGHT},
+      [] { return audioStats.maxDecodeTime; }, COLOR_THEME_PRIMARY1,
+      "Read(us): ", nullptr);
+
 #if defined(DEBUG_LATENCY)
   line = form->newLine(&grid2);
   line->padAll(2);
@@ -391,6 +414,7 @@ void DebugViewPage::build(FormWindow* window)
                               maxLuaInterval = 0;
                               maxLuaDuration = 0;
 #endif
+                              audioStats.reset();
                               return 0;
                             });
 
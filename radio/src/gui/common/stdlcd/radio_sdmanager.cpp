@@ -143,6 +143,7 @@ void onSdManagerMenu(const char * result)
     }
     POPUP_WARNING(sdCopyFile(clipboard.data.sd.filename,
                              clipboard.data.sd.directory, destNamePtr, lfn));
+    audioFileChanged(lfn);
     REFRESH_FILES();
   }
   else if (result == STR_RENAME_FILE) {
@@ -158,6 +159,7 @@ void onSdManagerMenu(const char * result)
   else if (result == STR_DELETE_FILE) {
     getSelectionFullPath(lfn);
     f_unlink(lfn);
+    audioFileChanged(lfn);
     strncpy(statusLineMsg, line, 13);
     strcpy(statusLineMsg+min((uint8_t)strlen(statusLineMsg), (uint8_t)13), STR_REMOVED);
     showStatusLine();
@@ -572,6 +574,7 @@ void menuRadioSdManager(event_t _event)
               reusableBuffer.sdManager.lines[i][efflen] = 0;
             }
             f_rename(reusableBuffer.sdManager.originalName, reusableBuffer.sdManager.lines[i]);
+            audioFileChanged(reusableBuffer.sdManager.lines[i]);
             REFRESH_FILES();
           }
         }
@@ -73,6 +73,38 @@ void fatfsUnregisterDrivers()
   _fatfs_n_drives = 0;
 }
 
+void fatfsSync(uint8_t pdrv)
+{
+  if (pdrv >= _fatfs_n_drives || !_fatfs_drives[pdrv].initialized) {
+    return;
+  }
+
+#if FF_FS_REENTRANT != 0
+  RTOS_LOCK_MUTEX(_fatfs_drives[pdrv].mutex);
+#endif
+  disk_ioctl(pdrv, CTRL_SYNC, 0);
+#if FF_FS_REENTRANT != 0
+  RTOS_UNLOCK_MUTEX(_fatfs_drives[pdrv].mutex);
+#endif
+}
+
+void fatfsIdle(uint8_t pdrv, uint32_t budgetMs)
+{
+  if (pdrv >= _fatfs_n_drives || !_fatfs_drives[pdrv].initialized) {
+    return;
+  }
+
+#if FF_FS_REENTRANT != 0
+  if (!RTOS_TRYLOCK_MUTEX(_fatfs_drives[pdrv].mutex)) {
+    return;
+  }
+#endif
+  disk_ioctl(pdrv, CTRL_IDLE, &budgetMs);
+#if FF_FS_REENTRANT != 0
+  RTOS_UNLOCK_MUTEX(_fatfs_drives[pdrv].mutex);
+#endif
+}
+
 const diskio_driver_t* fatfsGetDriver(uint8_t pdrv)
 {
   if (pdrv >= _fatfs_n_drives) {
@@ -45,6 +45,15 @@ int fatfsRegisterDriver(const diskio_driver_t* drv, uint8_t lun);
 // gracefully tear down all drivers
 void fatfsUnregisterDrivers();
 
+// writes back whatever a driver delayed, under the FatFs volume lock
+void fatfsSync(uint8_t pdrv);
+
+// driver specific ioctl: background work for about *(uint32_t*)buff ms
+#define CTRL_IDLE 64
+
+// lets a driver do background work, unless the volume is in use
+void fatfsIdle(uint8_t pdrv, uint32_t budgetMs);
+
 // returns a pyhsical disk driver or NULL
 const diskio_driver_t* fatfsGetDriver(uint8_t pdrv);
 
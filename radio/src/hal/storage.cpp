@@ -44,7 +44,7 @@
     .status = _STORAGE_DRIVER.status,
     .read = disk_cache_read,
     .write = disk_cache_write,
-    .ioctl = _STORAGE_DRIVER.ioctl,
+    .ioctl = disk_cache_ioctl,
   };
 #endif
 
@@ -77,6 +77,29 @@ void storagePreMountHook()
 #endif
 }
 
+void storagePreUnmountHook()
+{
+  // FatFs does not sync the disk when unmounting
+  fatfsSync(0);
+}
+
+void storagePeriodicHook()
+{
+#if defined(DISK_CACHE_WRITEBACK)
+  if (diskCache.flushDue()) {
+    fatfsSync(0);
+  }
+#endif
+}
+
+// Background work of the storage driver, done in slices
+#define STORAGE_IDLE_BUDGET_MS  20
+
+void storageIdleHook()
+{
+  fatfsIdle(0, STORAGE_IDLE_BUDGET_MS);
+}
+
 bool storageIsPresent()
 {
   return (_STORAGE_DRIVER.status(0) & STA_NODISK) == 0;
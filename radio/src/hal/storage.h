@@ -31,6 +31,15 @@ void storageDeInit();
 // Called before the storage is mounted
 void storagePreMountHook();
 
+// Called before the storage is unmounted
+void storagePreUnmountHook();
+
+// Called periodically from the UI task
+void storagePeriodicHook();
+
+// Called periodically from the UI task while the radio is not used
+void storageIdleHook();
+
 bool storageIsPresent();
 
 #define SD_CARD_PRESENT() storageIsPresent()
@@ -27,14 +27,46 @@
 #include "hal/adc_driver.h"
 #include "hal/switch_driver.h"
 
+#if defined(LOGS_BINARY)
+  #include "logs_binary.h"
+#endif
+
 #if defined(LIBOPENUI)
   #include "libopenui.h"
 #endif
 
 FIL g_oLogFile __DMA;
 uint8_t logDelay100ms;
+#if defined(LOGS_BINARY)
+uint8_t logFastRate;
+#endif
 static tmr10ms_t lastLogTime = 0;
 
+// Growing the file cluster by cluster makes FatFs update the FAT on
+// every few writes, which cheap SD cards answer with long stalls. The
+// file is instead allocated in large contiguous extents, then truncated
+// to what was written when synced or closed: after a power loss, the
+// file ends with the last synced record.
+#if !defined(SIMU) || defined(SIMU_DISKIO)
+  #define LOGS_PREALLOCATE
+#endif
+
+#if defined(COLORLCD)
+  #define LOGS_EXTENT_SIZE      (1024 * 1024)
+#else
+  #define LOGS_EXTENT_SIZE      (256 * 1024)
+#endif
+
+#define LOGS_SYNC_PERIOD_MS     10000
+
+// room reserved before each CSV row, longer rows simply grow the file
+#define LOGS_CSV_ROW_MAX        1024
+
+static FSIZE_t logAllocatedSize;
+static uint32_t logLastSync;
+
+LogsWriteStats logsWriteStats;
+
 #if !defined(SIMU)
 #include <FreeRTOS/include/FreeRTOS.h>
 #include <FreeRTOS/include/timers.h>
@@ -100,7 +132,10 @@ void initLoggingTimer() {                                       // called cyclic
 }
 #endif
 
+#if !defined(LOGS_BINARY)
 void writeHeader();
+static void buildCsvColumns(bool header);
+#endif
 
 int getSwitchState(uint8_t swtch) {
   int value = getValue(MIXSRC_FIRST_SWITCH + swtch);
@@ -112,6 +147,89 @@ void logsInit()
   memset(&g_oLogFile, 0, sizeof(g_oLogFile));
 }
 
+static void logsPreallocate()
+{
+  logAllocatedSize = f_size(&g_oLogFile);
+  logLastSync = RTOS_GET_MS();
+
+#if defined(LOGS_PREALLOCATE)
+  // f_expand only works on empty files, it fails as well when there is
+  // no contiguous free area: logsReserve() will then grow the file
+  if (logAllocatedSize == 0 &&
+      f_expand(&g_oLogFile, LOGS_EXTENT_SIZE, 1) == FR_OK) {
+    logAllocatedSize = LOGS_EXTENT_SIZE;
+    logsWriteStats.extents++;
+  }
+#endif
+}
+
+FRESULT logsReserve(UINT size)
+{
+#if defined(LOGS_PREALLOCATE)
+  FSIZE_t position = f_tell(&g_oLogFile);
+  if (position + size <= logAllocatedSize) {
+    return FR_OK;
+  }
+
+  // seeking past the end of a file open for writing allocates the
+  // clusters at once, next to each other when the card allows it
+  FRESULT result = f_lseek(&g_oLogFile, position + size + LOGS_EXTENT_SIZE);
+  if (result == FR_OK) {
+    // shorter than requested when the card is full
+    logAllocatedSize = f_tell(&g_oLogFile);
+    result = f_lseek(&g_oLogFile, position);
+    logsWriteStats.extents++;
+  }
+  return result;
+#else
+  (void)size;
+  return FR_OK;
+#endif
+}
+
+void logsWritten(uint32_t startMs)
+{
+  uint32_t now = RTOS_GET_MS();
+  uint32_t latency = now - startMs;
+
+  uint8_t bucket = 0;
+  while (bucket < LOGS_LATENCY_BUCKETS - 1 && latency >= (1u << bucket)) {
+    bucket++;
+  }
+  logsWriteStats.latency[bucket]++;
+  if (latency > logsWriteStats.maxLatency) {
+    logsWriteStats.maxLatency = latency;
+  }
+
+  // commit the directory entry once in a while, so that a power loss
+  // doesn't lose the whole session
+  if (now - logLastSync >= LOGS_SYNC_PERIOD_MS) {
+    logLastSync = now;
+#if defined(LOGS_PREALLOCATE)
+    // the size committed is the one written, not the extent: the next
+    // write allocates a new one
+    if (f_truncate(&g_oLogFile) == FR_OK) {
+      logAllocatedSize = f_tell(&g_oLogFile);
+    }
+#endif
+    if (f_sync(&g_oLogFile) == FR_OK) {
+      logsWriteStats.syncs++;
+    }
+  }
+}
+
+void logsTruncate()
+{
+#if defined(LOGS_PREALLOCATE)
+  // drop the unused part of the last extent
+  f_truncate(&g_oLogFile);
+#endif
+
+  TRACE("logs: %d extents, %d syncs, max write %dms",
+        logsWriteStats.extents, logsWriteStats.syncs,
+        logsWriteStats.maxLatency);
+}
+
 const char * logsOpen()
 {
   // Determine and set log file filename
@@ -165,6 +283,25 @@ const char * logsOpen()
   tmp = strAppendDate(tmp, true);
 #endif
 
+#if defined(LOGS_BINARY)
+  // the column layout is only valid for this session:
+  // always start a new file
+  strcpy(tmp, LOGS_BINARY_EXT);
+
+  result = f_open(&g_oLogFile, filename, FA_CREATE_ALWAYS | FA_WRITE);
+  if (result != FR_OK) {
+    return SDCARD_ERROR(result);
+  }
+
+  logsPreallocate();
+
+  error = logsBinaryOpen();
+  if (error) {
+    f_close(&g_oLogFile);
+    g_oLogFile.obj.fs = 0;
+    return error;
+  }
+#else
   strcpy(tmp, STR_LOGS_EXT);
 
   result = f_open(&g_oLogFile, filename, FA_OPEN_ALWAYS | FA_WRITE | FA_OPEN_APPEND);
@@ -172,9 +309,19 @@ const char * logsOpen()
     return SDCARD_ERROR(result);
   }
 
-  if (f_size(&g_oLogFile) == 0) {
+  bool empty = (f_size(&g_oLogFile) == 0);
+  logsPreallocate();
+
+  if (empty) {
+    uint32_t start = RTOS_GET_MS();
+    logsReserve(LOGS_CSV_ROW_MAX);
     writeHeader();
+    logsWritten(start);
+  }
+  else {
+    buildCsvColumns(false);
   }
+#endif
 
   return nullptr;
 }
@@ -182,29 +329,173 @@ const char * logsOpen()
 void logsClose()
 {
   if (g_oLogFile.obj.fs && sdMounted()) {
+#if defined(LOGS_BINARY)
+    logsBinaryClose();
+#else
+    logsTruncate();
     if (f_close(&g_oLogFile) != FR_OK) {
       // close failed, forget file
       g_oLogFile.obj.fs = 0;
     }
+#endif
     lastLogTime = 0;
   }
+}
 
+uint32_t getLogicalSwitchesStates(uint8_t first)
+{
+  uint32_t result = 0;
+  for (uint8_t i=0; i<32; i++) {
+    result |= (getSwitch(SWSRC_FIRST_LOGICAL_SWITCH+first+i) << i);
+  }
+  return result;
 }
 
-void writeHeader()
+#if !defined(LOGS_BINARY)
+// The CSV columns only depend on the sensors and the hardware config,
+// which can't change while a file is open (see logsClose() callers):
+// they are compiled once per file into a list of formatters instead of
+// being filtered again on every row.
+typedef char * (*CsvFormatter)(char * dest, uint8_t index);
+
+struct CsvColumn {
+  CsvFormatter format;
+  uint8_t index;
+};
+
+#define LOGS_CSV_MAX_COLUMNS  (MAX_TELEMETRY_SENSORS + MAX_ANALOG_INPUTS + MAX_SWITCHES)
+
+// rows are formatted in a RAM buffer, written once full or at the end
+// of the row: a column never needs more than LOGS_CSV_COLUMN_MAX chars
+#define LOGS_CSV_BUFFER_SIZE  512
+#define LOGS_CSV_COLUMN_MAX   (2 * TELEMETRY_SENSOR_TEXT_LENGTH)
+
+static CsvColumn csvColumns[LOGS_CSV_MAX_COLUMNS];
+static uint8_t csvColumnsCount;
+static char csvBuffer[LOGS_CSV_BUFFER_SIZE];
+
+static char * appendDecimal(char * s, int32_t value, uint8_t precision)
 {
-#if defined(RTCLOCK)
-  f_puts("Date,Time,", &g_oLogFile);
-#else
-  f_puts("Time,", &g_oLogFile);
-#endif
+  if (value < 0) {
+    *s++ = '-';
+    value = -value;
+  }
+  if (precision == 0) {
+    return strAppendUnsigned(s, value);
+  }
+  int32_t divisor = 10;
+  for (uint8_t i = 1; i < precision; i++) {
+    divisor *= 10;
+  }
+  div_t qr = div(value, divisor);
+  s = strAppendUnsigned(s, qr.quot);
+  *s++ = '.';
+  return strAppendUnsigned(s, qr.rem, precision);
+}
 
+static char * formatSensor(char * s, uint8_t index)
+{
+  return appendDecimal(s, telemetryItems[index].value, 0);
+}
+
+static char * formatSensorPrec1(char * s, uint8_t index)
+{
+  return appendDecimal(s, telemetryItems[index].value, 1);
+}
+
+static char * formatSensorPrec2(char * s, uint8_t index)
+{
+  return appendDecimal(s, telemetryItems[index].value, 2);
+}
+
+static char * formatSensorGps(char * s, uint8_t index)
+{
+  const TelemetryItem & telemetryItem = telemetryItems[index];
+  if (telemetryItem.gps.longitude && telemetryItem.gps.latitude) {
+    // 1e-6 degrees
+    s = appendDecimal(s, telemetryItem.gps.latitude, 6);
+    *s++ = ' ';
+    s = appendDecimal(s, telemetryItem.gps.longitude, 6);
+  }
+  return s;
+}
+
+static char * formatSensorDateTime(char * s, uint8_t index)
+{
+  const TelemetryItem & telemetryItem = telemetryItems[index];
+  s = strAppendUnsigned(s, telemetryItem.datetime.year, 4);
+  *s++ = '-';
+  s = strAppendUnsigned(s, telemetryItem.datetime.month, 2);
+  *s++ = '-';
+  s = strAppendUnsigned(s, telemetryItem.datetime.day, 2);
+  *s++ = ' ';
+  s = strAppendUnsigned(s, telemetryItem.datetime.hour, 2);
+  *s++ = ':';
+  s = strAppendUnsigned(s, telemetryItem.datetime.min, 2);
+  *s++ = ':';
+  return strAppendUnsigned(s, telemetryItem.datetime.sec, 2);
+}
+
+static char * formatSensorText(char * s, uint8_t index)
+{
+  *s++ = '"';
+  s = strAppend(s, telemetryItems[index].text, TELEMETRY_SENSOR_TEXT_LENGTH);
+  *s++ = '"';
+  return s;
+}
+
+static char * formatMainInput(char * s, uint8_t index)
+{
+  // the stick mode may change while logging
+  auto offset = adcGetInputOffset(ADC_INPUT_MAIN);
+  return strAppendSigned(s, calibratedAnalogs[inputMappingConvertMode(offset + index)]);
+}
+
+static char * formatFlexInput(char * s, uint8_t index)
+{
+  return strAppendSigned(s, calibratedAnalogs[index]);
+}
+
+static char * formatSwitch(char * s, uint8_t index)
+{
+  return strAppendSigned(s, getSwitchState(index));
+}
+
+static void addCsvColumn(CsvFormatter format, uint8_t index)
+{
+  if (csvColumnsCount < LOGS_CSV_MAX_COLUMNS) {
+    csvColumns[csvColumnsCount++] = {format, index};
+  }
+}
+
+static CsvFormatter getSensorFormatter(const TelemetrySensor & sensor)
+{
+  if (sensor.unit == UNIT_GPS)
+    return formatSensorGps;
+  else if (sensor.unit == UNIT_DATETIME)
+    return formatSensorDateTime;
+  else if (sensor.unit == UNIT_TEXT)
+    return formatSensorText;
+  else if (sensor.prec == 2)
+    return formatSensorPrec2;
+  else if (sensor.prec == 1)
+    return formatSensorPrec1;
+  else
+    return formatSensor;
+}
+
+// compiles the columns, and writes their names when 'header' is set
+static void buildCsvColumns(bool header)
+{
+  csvColumnsCount = 0;
 
   char label[TELEM_LABEL_LEN+7];
   for (int i=0; i<MAX_TELEMETRY_SENSORS; i++) {
     if (isTelemetryFieldAvailable(i)) {
       TelemetrySensor & sensor = g_model.telemetrySensors[i];
       if (sensor.logs) {
+        addCsvColumn(getSensorFormatter(sensor), i);
+        if (!header) continue;
         memset(label, 0, sizeof(label));
         strncpy(label, sensor.label, TELEM_LABEL_LEN);
         uint8_t unit = sensor.unit;
@@ -222,14 +513,19 @@ void writeHeader()
 
   auto n_inputs = adcGetMaxInputs(ADC_INPUT_MAIN);
   for (uint8_t i = 0; i < n_inputs; i++) {
+    addCsvColumn(formatMainInput, i);
+    if (!header) continue;
     const char* p = analogGetCanonicalName(ADC_INPUT_MAIN, i);
     while (*p) { f_putc(*(p++), &g_oLogFile); }
     f_putc(',', &g_oLogFile);
   }
 
   n_inputs = adcGetMaxInputs(ADC_INPUT_FLEX);
+  auto offset = adcGetInputOffset(ADC_INPUT_FLEX);
   for (uint8_t i = 0; i < n_inputs; i++) {
     if (!IS_POT_AVAILABLE(i)) continue;
+    addCsvColumn(formatFlexInput, offset + i);
+    if (!header) continue;
     const char* p = analogGetCanonicalName(ADC_INPUT_FLEX, i);
     while (*p) { f_putc(*(p++), &g_oLogFile); }
     f_putc(',', &g_oLogFile);
@@ -237,6 +533,8 @@ void writeHeader()
 
   for (uint8_t i = 0; i < switchGetMaxSwitches(); i++) {
     if (SWITCH_EXISTS(i)) {
+      addCsvColumn(formatSwitch, i);
+      if (!header) continue;
       char s[LEN_SWITCH_NAME + 2];
       char * temp;
       temp = getSwitchName(s, i);
@@ -245,6 +543,18 @@ void writeHeader()
       f_puts(s, &g_oLogFile);
     }
   }
+}
+
+void writeHeader()
+{
+#if defined(RTCLOCK)
+  f_puts("Date,Time,", &g_oLogFile);
+#else
+  f_puts("Time,", &g_oLogFile);
+#endif
+
+  buildCsvColumns(true);
+
   f_puts("LSW,", &g_oLogFile);
   
   for (uint8_t channel = 0; channel < MAX_OUTPUT_CHANNELS; channel++) {
@@ -254,14 +564,93 @@ void writeHeader()
   f_puts("TxBat(V)\n", &g_oLogFile);
 }
 
-uint32_t getLogicalSwitchesStates(uint8_t first)
+static char * appendHex32(char * s, uint32_t value)
 {
-  uint32_t result = 0;
-  for (uint8_t i=0; i<32; i++) {
-    result |= (getSwitch(SWSRC_FIRST_LOGICAL_SWITCH+first+i) << i);
+  for (int8_t shift = 28; shift >= 0; shift -= 4) {
+    uint8_t digit = (value >> shift) & 0x0F;
+    *s++ = (digit >= 10 ? 'A' - 10 : '0') + digit;
+  }
+  return s;
+}
+
+// writes the buffer when another column might not fit
+static char * csvFlush(char * s, bool force, FRESULT & result)
+{
+  UINT size = s - csvBuffer;
+  if (size > 0 && (force || size > LOGS_CSV_BUFFER_SIZE - LOGS_CSV_COLUMN_MAX)) {
+    UINT written;
+    FRESULT res = f_write(&g_oLogFile, csvBuffer, size, &written);
+    if (res == FR_OK && written != size) {
+      res = FR_DENIED;
+    }
+    if (result == FR_OK) {
+      result = res;
+    }
+    return csvBuffer;
+  }
+  return s;
+}
+
+static FRESULT writeCsvRow()
+{
+  FRESULT result = FR_OK;
+  char * s = csvBuffer;
+
+#if defined(RTCLOCK)
+  {
+    static struct gtm utm;
+    static gtime_t lastRtcTime = 0;
+    if (g_rtcTime != lastRtcTime) {
+      lastRtcTime = g_rtcTime;
+      gettime(&utm);
+    }
+    s = strAppendUnsigned(s, utm.tm_year+TM_YEAR_BASE, 4);
+    *s++ = '-';
+    s = strAppendUnsigned(s, utm.tm_mon+1, 2);
+    *s++ = '-';
+    s = strAppendUnsigned(s, utm.tm_mday, 2);
+    *s++ = ',';
+    s = strAppendUnsigned(s, utm.tm_hour, 2);
+    *s++ = ':';
+    s = strAppendUnsigned(s, utm.tm_min, 2);
+    *s++ = ':';
+    s = strAppendUnsigned(s, utm.tm_sec, 2);
+    *s++ = '.';
+    s = strAppendUnsigned(s, g_ms100, 2);
+    *s++ = '0';
+    *s++ = ',';
   }
+#else
+  s = strAppendUnsigned(s, get_tmr10ms());
+  *s++ = ',';
+#endif
+
+  for (uint8_t i = 0; i < csvColumnsCount; i++) {
+    const CsvColumn & column = csvColumns[i];
+    s = column.format(s, column.index);
+    *s++ = ',';
+    s = csvFlush(s, false, result);
+  }
+
+  *s++ = '0';
+  *s++ = 'x';
+  s = appendHex32(s, getLogicalSwitchesStates(32));
+  s = appendHex32(s, getLogicalSwitchesStates(0));
+  *s++ = ',';
+
+  for (uint8_t channel = 0; channel < MAX_OUTPUT_CHANNELS; channel++) {
+    s = strAppendSigned(s, PPM_CENTER+channelOutputs[channel]/2); // in us
+    *s++ = ',';
+    s = csvFlush(s, false, result);
+  }
+
+  s = appendDecimal(s, g_vbat100mV, 1);
+  *s++ = '\n';
+  csvFlush(s, true, result);
+
   return result;
 }
+#endif
 
 void logsWrite()
 {
@@ -304,97 +693,33 @@ void logsWrite()
         return;
       }
 
-
-#if defined(RTCLOCK)
-      {
-        static struct gtm utm;
-        static gtime_t lastRtcTime = 0;
-        if (g_rtcTime != lastRtcTime) {
-          lastRtcTime = g_rtcTime;
-          gettime(&utm);
+#if defined(LOGS_BINARY)
+      const char * writerError = logsBinaryError();
+      if (writerError) {
+        if (writerError != error_displayed) {
+          error_displayed = writerError;
+          POPUP_WARNING_ON_UI_TASK(writerError, nullptr, false);
         }
-        f_printf(&g_oLogFile, "%4d-%02d-%02d,%02d:%02d:%02d.%02d0,", utm.tm_year+TM_YEAR_BASE, utm.tm_mon+1, utm.tm_mday, utm.tm_hour, utm.tm_min, utm.tm_sec, g_ms100);
-      }
-#else
-      f_printf(&g_oLogFile, "%d,", tmr10ms);
-#endif
-
-      for (int i=0; i<MAX_TELEMETRY_SENSORS; i++) {
-        if (isTelemetryFieldAvailable(i)) {
-          TelemetrySensor & sensor = g_model.telemetrySensors[i];
-          TelemetryItem & telemetryItem = telemetryItems[i];
-          if (sensor.logs) {
-            if (sensor.unit == UNIT_GPS) {
-              if (telemetryItem.gps.longitude && telemetryItem.gps.latitude) {
-                div_t qr = div((int)telemetryItem.gps.latitude, 1000000);
-                if (telemetryItem.gps.latitude < 0) f_printf(&g_oLogFile, "-");
-                f_printf(&g_oLogFile, "%d.%06d ", abs(qr.quot), abs(qr.rem));
-                qr = div((int)telemetryItem.gps.longitude, 1000000);
-                if (telemetryItem.gps.longitude < 0) f_printf(&g_oLogFile, "-");
-                f_printf(&g_oLogFile, "%d.%06d,", abs(qr.quot), abs(qr.rem));
-              }
-              else {
-                f_printf(&g_oLogFile, ",");
-              }
-            }
-            else if (sensor.unit == UNIT_DATETIME) {
-              f_printf(&g_oLogFile, "%4d-%02d-%02d %02d:%02d:%02d,", telemetryItem.datetime.year, telemetryItem.datetime.month, telemetryItem.datetime.day, telemetryItem.datetime.hour, telemetryItem.datetime.min, telemetryItem.datetime.sec);
-            }
-            else if (sensor.unit == UNIT_TEXT) {
-              f_printf(&g_oLogFile, "\"%s\",", telemetryItem.text);
-            }
-            else if (sensor.prec == 2) {
-              div_t qr = div((int)telemetryItem.value, 100);
-              if (telemetryItem.value < 0) f_printf(&g_oLogFile, "-");
-              f_printf(&g_oLogFile, "%d.%02d,", abs(qr.quot), abs(qr.rem));
-            }
-            else if (sensor.prec == 1) {
-              div_t qr = div((int)telemetryItem.value, 10);
-              if (telemetryItem.value < 0) f_printf(&g_oLogFile, "-");
-              f_printf(&g_oLogFile, "%d.%d,", abs(qr.quot), abs(qr.rem));
-            }
-            else {
-              f_printf(&g_oLogFile, "%d,", telemetryItem.value);
-            }
-          }
-        }
-      }
-
-      auto n_inputs = adcGetMaxInputs(ADC_INPUT_MAIN);
-      auto offset = adcGetInputOffset(ADC_INPUT_MAIN);
-
-      for (uint8_t i = 0; i < n_inputs; i++) {
-        f_printf(&g_oLogFile, "%d,", calibratedAnalogs[inputMappingConvertMode(offset + i)]);
-      }
-
-      n_inputs = adcGetMaxInputs(ADC_INPUT_FLEX);
-      offset = adcGetInputOffset(ADC_INPUT_FLEX);
-
-      for (uint8_t i = 0; i < n_inputs; i++) {
-        if (IS_POT_AVAILABLE(i))
-          f_printf(&g_oLogFile, "%d,", calibratedAnalogs[offset + i]);
-      }
-
-      for (uint8_t i = 0; i < switchGetMaxSwitches(); i++) {
-        if (SWITCH_EXISTS(i)) {
-          f_printf(&g_oLogFile, "%d,", getSwitchState(i));
-        }
-      }
-      f_printf(&g_oLogFile, "0x%08X%08X,", getLogicalSwitchesStates(32),
-               getLogicalSwitchesStates(0));
-
-      for (uint8_t channel = 0; channel < MAX_OUTPUT_CHANNELS; channel++) {
-        f_printf(&g_oLogFile, "%d,", PPM_CENTER+channelOutputs[channel]/2); // in us
+        logsClose();
+        return;
       }
 
-      div_t qr = div(g_vbat100mV, 10);
-      int result = f_printf(&g_oLogFile, "%d.%d\n", abs(qr.quot), abs(qr.rem));
+      logsBinaryWrite();
+#if defined(SIMU)
+      logsBinaryFlush();
+#endif
+#else
+      uint32_t writeStart = RTOS_GET_MS();
+      logsReserve(LOGS_CSV_ROW_MAX);
+      FRESULT result = writeCsvRow();
+      logsWritten(writeStart);
 
-      if (result<0 && !error_displayed) {
+      if (result != FR_OK && !error_displayed) {
         error_displayed = STR_SDCARD_ERROR;
         POPUP_WARNING_ON_UI_TASK(STR_SDCARD_ERROR, nullptr, false);
         logsClose();
       }
+#endif
     }
   }
   else {
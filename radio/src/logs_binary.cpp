@@ -0,0 +1,593 @@
+/*
+ * Copyright (C) EdgeTX
+ *
+ * Based on code named
+ *   opentx - https://github.com/opentx/opentx
+ *   th9x - http://code.google.com/p/th9x
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "opentx.h"
+#include "tasks.h"
+#include "fifo.h"
+#include "logs_binary.h"
+
+#include "analogs.h"
+#include "switches.h"
+#include "hal/adc_driver.h"
+#include "hal/switch_driver.h"
+
+// Records are queued by the logging timer into one of two RAM buffers.
+// Full buffers are written by a low priority task, always as whole
+// buffers, so that the file position stays sector aligned and FatFs
+// can write straight from the buffer without going through its window.
+#if defined(COLORLCD)
+  #define LOGS_BINARY_BUFFER_SIZE   (8 * LOGS_BINARY_SECTOR_SIZE)
+#else
+  #define LOGS_BINARY_BUFFER_SIZE   (2 * LOGS_BINARY_SECTOR_SIZE)
+#endif
+
+#define LOGS_BINARY_MAX_COLUMNS                                   \
+  (MAX_TELEMETRY_SENSORS + MAX_ANALOG_INPUTS + MAX_SWITCHES + \
+   MAX_OUTPUT_CHANNELS + 2)
+
+#define LOGS_FAST_MAX_COLUMNS (MAX_ANALOG_INPUTS + MAX_OUTPUT_CHANNELS)
+
+// Fast group samples are taken by the mixer and queued until the writer
+// task turns them into records: the queue must absorb SD card stalls
+#if defined(COLORLCD)
+  #define LOGS_SAMPLES_FIFO_SIZE    32
+#else
+  #define LOGS_SAMPLES_FIFO_SIZE    16
+#endif
+
+#define LOGS_TASK_PERIOD_MS 20
+
+enum LogColumnSource {
+  LOG_SOURCE_SENSOR,
+  LOG_SOURCE_MAIN_INPUT,
+  LOG_SOURCE_FLEX_INPUT,
+  LOG_SOURCE_SWITCH,
+  LOG_SOURCE_LOGICAL_SWITCHES,
+  LOG_SOURCE_CHANNEL,
+  LOG_SOURCE_TX_BATTERY,
+};
+
+struct LogColumn {
+  uint8_t source;
+  uint8_t index;
+  uint8_t type;
+  uint8_t precision;
+  uint8_t group;
+};
+
+struct LogSample {
+  uint32_t timestamp;
+  int16_t values[LOGS_FAST_MAX_COLUMNS];
+};
+
+static LogColumn logColumns[LOGS_BINARY_MAX_COLUMNS];
+static uint16_t logColumnsCount;
+static uint16_t logRecordSize[LOG_GROUPS_COUNT];
+static uint32_t logStartMs;
+
+static LogColumn logFastColumns[LOGS_FAST_MAX_COLUMNS];
+static uint8_t logFastColumnsCount;
+static volatile uint16_t logFastPeriod;  // ms, 0 when not sampling
+static uint32_t logNextSample;
+static Fifo<LogSample, LOGS_SAMPLES_FIFO_SIZE> logSamples;
+
+static uint8_t logBuffers[2][LOGS_BINARY_BUFFER_SIZE] __DMA;
+static volatile bool logBufferFull[2];
+static uint8_t logActiveBuffer;
+static uint16_t logActiveLength;
+
+static const char * volatile logWriterError;
+
+// logFileMutex protects the file, logBufferMutex the RAM buffers: records
+// are appended by both the logging timer and the writer task
+static RTOS_MUTEX_HANDLE logFileMutex;
+static RTOS_MUTEX_HANDLE logBufferMutex;
+
+LogsBinaryStats logsBinaryStats;
+
+#if !defined(SIMU)
+RTOS_TASK_HANDLE logsTaskId;
+RTOS_DEFINE_STACK(logsTaskId, logsStack, LOGS_STACK_SIZE);
+
+TASK_FUNCTION(logsTask)
+{
+  while (true) {
+    logsBinaryFlush();
+    RTOS_WAIT_MS(LOGS_TASK_PERIOD_MS);
+  }
+  TASK_RETURN();
+}
+#endif
+
+void logsBinaryStart()
+{
+  RTOS_CREATE_MUTEX(logFileMutex);
+  RTOS_CREATE_MUTEX(logBufferMutex);
+#if !defined(SIMU)
+  RTOS_CREATE_TASK(logsTaskId, logsTask, "logs", logsStack, LOGS_STACK_SIZE,
+                   LOGS_TASK_PRIO);
+#endif
+}
+
+uint8_t logColumnSize(uint8_t type)
+{
+  switch (type) {
+    case LOG_COLUMN_INT8:
+      return 1;
+    case LOG_COLUMN_INT16:
+      return 2;
+    case LOG_COLUMN_INT32:
+      return 4;
+    case LOG_COLUMN_GPS:
+    case LOG_COLUMN_DATETIME:
+    case LOG_COLUMN_BITS64:
+      return 8;
+    case LOG_COLUMN_TEXT:
+      return LOG_COLUMN_TEXT_LENGTH;
+    default:
+      return 0;
+  }
+}
+
+static void addColumn(uint8_t source, uint8_t index, uint8_t type,
+                      uint8_t precision = 0, uint8_t group = LOG_GROUP_SLOW)
+{
+  uint8_t size = logColumnSize(type);
+
+  // a record must always fit in a single buffer
+  if (logColumnsCount >= LOGS_BINARY_MAX_COLUMNS ||
+      logRecordSize[group] + size > LOGS_BINARY_BUFFER_SIZE) {
+    return;
+  }
+
+  LogColumn column = {source, index, type, precision, group};
+  if (group == LOG_GROUP_FAST) {
+    if (logFastColumnsCount >= LOGS_FAST_MAX_COLUMNS) return;
+    logFastColumns[logFastColumnsCount++] = column;
+  }
+
+  logColumns[logColumnsCount++] = column;
+  logRecordSize[group] += size;
+}
+
+static void buildColumns(uint8_t controlsGroup)
+{
+  logColumnsCount = 0;
+  logFastColumnsCount = 0;
+  for (uint8_t group = 0; group < LOG_GROUPS_COUNT; group++) {
+    logRecordSize[group] = sizeof(uint8_t) + sizeof(uint32_t);  // group + timestamp
+  }
+
+  for (int i = 0; i < MAX_TELEMETRY_SENSORS; i++) {
+    if (!isTelemetryFieldAvailable(i)) continue;
+    const TelemetrySensor& sensor = g_model.telemetrySensors[i];
+    if (!sensor.logs) continue;
+    if (sensor.unit == UNIT_GPS)
+      addColumn(LOG_SOURCE_SENSOR, i, LOG_COLUMN_GPS);
+    else if (sensor.unit == UNIT_DATETIME)
+      addColumn(LOG_SOURCE_SENSOR, i, LOG_COLUMN_DATETIME);
+    else if (sensor.unit == UNIT_TEXT)
+      addColumn(LOG_SOURCE_SENSOR, i, LOG_COLUMN_TEXT);
+    else
+      addColumn(LOG_SOURCE_SENSOR, i, LOG_COLUMN_INT32, sensor.prec);
+  }
+
+  auto n_inputs = adcGetMaxInputs(ADC_INPUT_MAIN);
+  for (uint8_t i = 0; i < n_inputs; i++) {
+    addColumn(LOG_SOURCE_MAIN_INPUT, i, LOG_COLUMN_INT16, 0, controlsGroup);
+  }
+
+  n_inputs = adcGetMaxInputs(ADC_INPUT_FLEX);
+  for (uint8_t i = 0; i < n_inputs; i++) {
+    if (IS_POT_AVAILABLE(i))
+      addColumn(LOG_SOURCE_FLEX_INPUT, i, LOG_COLUMN_INT16, 0, controlsGroup);
+  }
+
+  for (uint8_t i = 0; i < switchGetMaxSwitches(); i++) {
+    if (SWITCH_EXISTS(i))
+      addColumn(LOG_SOURCE_SWITCH, i, LOG_COLUMN_INT8);
+  }
+
+  addColumn(LOG_SOURCE_LOGICAL_SWITCHES, 0, LOG_COLUMN_BITS64);
+
+  for (uint8_t channel = 0; channel < MAX_OUTPUT_CHANNELS; channel++) {
+    addColumn(LOG_SOURCE_CHANNEL, channel, LOG_COLUMN_INT16, 0, controlsGroup);
+  }
+
+  addColumn(LOG_SOURCE_TX_BATTERY, 0, LOG_COLUMN_INT16, 1);
+}
+
+// same names as the CSV header
+static uint8_t getColumnName(const LogColumn& column, char* name)
+{
+  char* s = name;
+
+  switch (column.source) {
+    case LOG_SOURCE_SENSOR: {
+      const TelemetrySensor& sensor = g_model.telemetrySensors[column.index];
+      s = strAppend(s, sensor.label, TELEM_LABEL_LEN);
+      uint8_t unit = sensor.unit;
+      if (unit == UNIT_CELLS) unit = UNIT_VOLTS;
+      if (UNIT_RAW < unit && unit < UNIT_FIRST_VIRTUAL) {
+        *s++ = '(';
+        s = strAppend(s, STR_VTELEMUNIT[unit], 3);
+        *s++ = ')';
+      }
+      break;
+    }
+    case LOG_SOURCE_MAIN_INPUT:
+      s = strAppend(s, analogGetCanonicalName(ADC_INPUT_MAIN, column.index));
+      break;
+    case LOG_SOURCE_FLEX_INPUT:
+      s = strAppend(s, analogGetCanonicalName(ADC_INPUT_FLEX, column.index));
+      break;
+    case LOG_SOURCE_SWITCH:
+      s = getSwitchName(s, column.index);
+      break;
+    case LOG_SOURCE_LOGICAL_SWITCHES:
+      s = strAppend(s, "LSW");
+      break;
+    case LOG_SOURCE_CHANNEL:
+      s = strAppend(s, "CH");
+      s = strAppendUnsigned(s, column.index + 1);
+      s = strAppend(s, "(us)");
+      break;
+    case LOG_SOURCE_TX_BATTERY:
+      s = strAppend(s, "TxBat(V)");
+      break;
+  }
+
+  return s - name;
+}
+
+static FRESULT writeAll(const void* data, UINT size)
+{
+  uint32_t start = RTOS_GET_MS();
+  FRESULT result = logsReserve(size);
+  if (result == FR_OK) {
+    UINT written;
+    result = f_write(&g_oLogFile, data, size, &written);
+    if (result == FR_OK && written != size) {
+      result = FR_DENIED;  // card full
+    }
+  }
+  logsWritten(start);
+  return result;
+}
+
+static const char* writeError(FRESULT result)
+{
+  return result == FR_DENIED ? STR_SDCARD_FULL_EXT : SDCARD_ERROR(result);
+}
+
+const char* logsBinaryOpen()
+{
+  uint8_t groupCount = logFastRate > 0 ? LOG_GROUPS_COUNT : 1;
+  buildColumns(groupCount > 1 ? LOG_GROUP_FAST : LOG_GROUP_SLOW);
+
+  // the header is written synchronously, padded to a sector boundary,
+  // using the first buffer as scratch memory
+  char name[16];
+  uint32_t headerSize = sizeof(LogFileHeader);
+  for (uint16_t i = 0; i < logColumnsCount; i++) {
+    headerSize += sizeof(LogColumnHeader) + getColumnName(logColumns[i], name);
+  }
+  headerSize = (headerSize + LOGS_BINARY_SECTOR_SIZE - 1) &
+               ~(LOGS_BINARY_SECTOR_SIZE - 1);
+
+  LogFileHeader header;
+  memcpy(header.magic, "ETXL", sizeof(header.magic));
+  header.version = LOGS_BINARY_VERSION;
+  header.flags = 0;
+  header.columnCount = logColumnsCount;
+  header.groupCount = groupCount;
+  header.headerSize = headerSize;
+  header.startTime = 0;
+#if defined(RTCLOCK)
+  header.flags |= LOGS_BINARY_FLAG_RTC;
+  header.startTime = g_rtcTime;
+#endif
+
+  uint8_t* buffer = logBuffers[0];
+  uint32_t length = 0;
+  FRESULT result = FR_OK;
+
+  auto append = [&](const void* data, uint32_t size) {
+    auto src = (const uint8_t*)data;
+    while (size > 0 && result == FR_OK) {
+      uint32_t count = min<uint32_t>(size, LOGS_BINARY_BUFFER_SIZE - length);
+      memcpy(buffer + length, src, count);
+      length += count;
+      src += count;
+      size -= count;
+      if (length == LOGS_BINARY_BUFFER_SIZE) {
+        result = writeAll(buffer, length);
+        length = 0;
+      }
+    }
+  };
+
+  append(&header, sizeof(header));
+  for (uint16_t i = 0; i < logColumnsCount; i++) {
+    const LogColumn& column = logColumns[i];
+    LogColumnHeader columnHeader;
+    columnHeader.type = column.type;
+    columnHeader.precision = column.precision;
+    columnHeader.group = column.group;
+    columnHeader.nameLength = getColumnName(column, name);
+    append(&columnHeader, sizeof(columnHeader));
+    append(name, columnHeader.nameLength);
+  }
+
+  uint32_t padding = (LOGS_BINARY_SECTOR_SIZE - length) &
+                     (LOGS_BINARY_SECTOR_SIZE - 1);
+  memset(buffer + length, 0, padding);
+  length += padding;
+
+  if (result == FR_OK && length > 0) {
+    result = writeAll(buffer, length);
+  }
+
+  if (result != FR_OK) {
+    return writeError(result);
+  }
+
+  logBufferFull[0] = logBufferFull[1] = false;
+  logActiveBuffer = 0;
+  logActiveLength = 0;
+  logWriterError = nullptr;
+  logStartMs = RTOS_GET_MS();
+
+  logSamples.clear();
+  logNextSample = logStartMs;
+  if (groupCount > 1) {
+    logFastPeriod = max<uint16_t>(1000 / logFastRate, 1);
+  }
+
+  return nullptr;
+}
+
+static void logAppend(const void* data, uint16_t size)
+{
+  auto src = (const uint8_t*)data;
+  while (size > 0) {
+    uint16_t count =
+        min<uint16_t>(size, LOGS_BINARY_BUFFER_SIZE - logActiveLength);
+    memcpy(&logBuffers[logActiveBuffer][logActiveLength], src, count);
+    logActiveLength += count;
+    src += count;
+    size -= count;
+    if (logActiveLength == LOGS_BINARY_BUFFER_SIZE) {
+      logBufferFull[logActiveBuffer] = true;
+      logActiveBuffer ^= 1;
+      logActiveLength = 0;
+    }
+  }
+}
+
+static int16_t getColumnValue(const LogColumn& column)
+{
+  switch (column.source) {
+    case LOG_SOURCE_MAIN_INPUT:
+      return calibratedAnalogs[inputMappingConvertMode(
+          adcGetInputOffset(ADC_INPUT_MAIN) + column.index)];
+    case LOG_SOURCE_FLEX_INPUT:
+      return calibratedAnalogs[adcGetInputOffset(ADC_INPUT_FLEX) +
+                               column.index];
+    case LOG_SOURCE_CHANNEL:
+      return PPM_CENTER + channelOutputs[column.index] / 2;  // in us
+    case LOG_SOURCE_TX_BATTERY:
+      return g_vbat100mV;
+    default:
+      return 0;
+  }
+}
+
+static void logAppendColumn(const LogColumn& column)
+{
+  union {
+    int8_t i8;
+    int16_t i16;
+    int32_t i32;
+    int32_t gps[2];
+    uint8_t datetime[8];
+    char text[LOG_COLUMN_TEXT_LENGTH];
+    uint64_t bits;
+  } value;
+
+  memset(&value, 0, sizeof(value));
+
+  switch (column.source) {
+    case LOG_SOURCE_SENSOR: {
+      const TelemetryItem& item = telemetryItems[column.index];
+      if (column.type == LOG_COLUMN_GPS) {
+        value.gps[0] = item.gps.latitude;
+        value.gps[1] = item.gps.longitude;
+      } else if (column.type == LOG_COLUMN_DATETIME) {
+        value.datetime[0] = item.datetime.year & 0xFF;
+        value.datetime[1] = item.datetime.year >> 8;
+        value.datetime[2] = item.datetime.month;
+        value.datetime[3] = item.datetime.day;
+        value.datetime[4] = item.datetime.hour;
+        value.datetime[5] = item.datetime.min;
+        value.datetime[6] = item.datetime.sec;
+      } else if (column.type == LOG_COLUMN_TEXT) {
+        strncpy(value.text, item.text, LOG_COLUMN_TEXT_LENGTH);
+      } else {
+        value.i32 = item.value;
+      }
+      break;
+    }
+    case LOG_SOURCE_SWITCH:
+      value.i8 = getSwitchState(column.index);
+      break;
+    case LOG_SOURCE_LOGICAL_SWITCHES:
+      value.bits = ((uint64_t)getLogicalSwitchesStates(32) << 32) |
+                   getLogicalSwitchesStates(0);
+      break;
+    default:
+      value.i16 = getColumnValue(column);
+      break;
+  }
+
+  logAppend(&value, logColumnSize(column.type));
+}
+
+// must be called with logBufferMutex held
+static bool logAppendHeader(uint8_t group, uint32_t timestamp)
+{
+  // a record may span both buffers, but only if the second one
+  // has already been written to the card
+  uint32_t available = LOGS_BINARY_BUFFER_SIZE - logActiveLength;
+  if (!logBufferFull[logActiveBuffer ^ 1]) {
+    available += LOGS_BINARY_BUFFER_SIZE;
+  }
+
+  if (available < logRecordSize[group]) {
+    return false;
+  }
+
+  logAppend(&group, sizeof(group));
+  logAppend(&timestamp, sizeof(timestamp));
+  return true;
+}
+
+bool logsBinaryWrite()
+{
+  bool result = false;
+
+  // called from the timer task, which must never block: the record is
+  // dropped when the writer task holds the buffers
+  if (RTOS_TRYLOCK_MUTEX(logBufferMutex)) {
+    if (logAppendHeader(LOG_GROUP_SLOW, RTOS_GET_MS() - logStartMs)) {
+      for (uint16_t i = 0; i < logColumnsCount; i++) {
+        if (logColumns[i].group == LOG_GROUP_SLOW)
+          logAppendColumn(logColumns[i]);
+      }
+      result = true;
+    }
+    RTOS_UNLOCK_MUTEX(logBufferMutex);
+  }
+
+  if (result)
+    logsBinaryStats.records++;
+  else
+    logsBinaryStats.dropped++;
+
+  return result;
+}
+
+void logsSample()
+{
+  uint16_t period = logFastPeriod;
+  if (!period) return;
+
+  uint32_t now = RTOS_GET_MS();
+  if ((int32_t)(now - logNextSample) < 0) return;
+
+  logNextSample += period;
+  if ((int32_t)(now - logNextSample) >= 0) {
+    // too late: do not try to catch up
+    logNextSample = now + period;
+  }
+
+  if (logSamples.isFull()) {
+    logsBinaryStats.samplesDropped++;
+    return;
+  }
+
+  LogSample sample;
+  sample.timestamp = now - logStartMs;
+  for (uint8_t i = 0; i < logFastColumnsCount; i++) {
+    sample.values[i] = getColumnValue(logFastColumns[i]);
+  }
+
+  logSamples.push(sample);
+  logsBinaryStats.samples++;
+}
+
+static void appendSamples()
+{
+  LogSample sample;
+  while (logSamples.pop(sample)) {
+    RTOS_LOCK_MUTEX(logBufferMutex);
+    if (logAppendHeader(LOG_GROUP_FAST, sample.timestamp)) {
+      logAppend(sample.values, logFastColumnsCount * sizeof(int16_t));
+    } else {
+      logsBinaryStats.samplesDropped++;
+    }
+    RTOS_UNLOCK_MUTEX(logBufferMutex);
+  }
+}
+
+static void flushFullBuffers()
+{
+  for (uint8_t i = 0; i < 2; i++) {
+    if (!logBufferFull[i]) continue;
+    if (g_oLogFile.obj.fs && !logWriterError) {
+      FRESULT result = writeAll(logBuffers[i], LOGS_BINARY_BUFFER_SIZE);
+      if (result != FR_OK) {
+        logWriterError = writeError(result);
+      }
+      logsBinaryStats.flushes++;
+    }
+    logBufferFull[i] = false;
+  }
+}
+
+void logsBinaryFlush()
+{
+  appendSamples();
+
+  if (!logBufferFull[0] && !logBufferFull[1]) return;
+
+  RTOS_LOCK_MUTEX(logFileMutex);
+  flushFullBuffers();
+  RTOS_UNLOCK_MUTEX(logFileMutex);
+}
+
+void logsBinaryClose()
+{
+  logFastPeriod = 0;
+
+  RTOS_LOCK_MUTEX(logFileMutex);
+
+  flushFullBuffers();
+  appendSamples();
+  flushFullBuffers();
+  if (logActiveLength > 0 && !logWriterError) {
+    writeAll(logBuffers[logActiveBuffer], logActiveLength);
+  }
+  logActiveLength = 0;
+
+  logsTruncate();
+  if (f_close(&g_oLogFile) != FR_OK) {
+    // close failed, forget file
+    g_oLogFile.obj.fs = 0;
+  }
+
+  RTOS_UNLOCK_MUTEX(logFileMutex);
+}
+
+const char* logsBinaryError()
+{
+  return logWriterError;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) EdgeTX
+ *
+ * Based on code named
+ *   opentx - https://github.com/opentx/opentx
+ *   th9x - http://code.google.com/p/th9x
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "definitions.h"
+
+//
+// Binary log file layout (all values little-endian):
+//
+//  - LogFileHeader
+//  - columnCount times: LogColumnHeader followed by 'nameLength' chars
+//  - zero padding up to 'headerSize' (multiple of LOGS_BINARY_SECTOR_SIZE)
+//  - records: uint8_t group, uint32_t milliseconds since the file was
+//    opened, followed by the value of every column of that group
+//    (see LogColumnType)
+//
+// Columns are split into groups logged at different rates: readers
+// should hold the last value of the other groups' columns.
+//
+// Version 1 had a single group: no 'group' in LogColumnHeader nor in
+// records, and 'groupCount' was the record size.
+//
+// Companion (LogsDialog) and radio/util/logs2csv.py read this format,
+// keep them in sync when changing it.
+//
+
+#define LOGS_BINARY_EXT          ".etl"
+#define LOGS_BINARY_VERSION      2
+#define LOGS_BINARY_SECTOR_SIZE  512
+
+#define LOGS_BINARY_FLAG_RTC     0x01  // 'startTime' is valid
+
+enum LogColumnType {
+  LOG_COLUMN_INT8,      // int8_t
+  LOG_COLUMN_INT16,     // int16_t, 'precision' decimals
+  LOG_COLUMN_INT32,     // int32_t, 'precision' decimals
+  LOG_COLUMN_GPS,       // int32_t latitude, int32_t longitude (1e-6 degrees)
+  LOG_COLUMN_DATETIME,  // uint16_t year, uint8_t month, day, hour, min, sec, 0
+  LOG_COLUMN_TEXT,      // char[LOG_COLUMN_TEXT_LENGTH], not null terminated
+  LOG_COLUMN_BITS64,    // uint64_t
+  LOG_COLUMN_TYPES_COUNT
+};
+
+#define LOG_COLUMN_TEXT_LENGTH  16
+
+PACK(struct LogFileHeader {
+  char magic[4];          // "ETXL"
+  uint8_t version;
+  uint8_t flags;
+  uint16_t columnCount;
+  uint16_t groupCount;
+  uint16_t headerSize;
+  uint32_t startTime;     // RTC time when the file was opened
+});
+
+PACK(struct LogColumnHeader {
+  uint8_t type;
+  uint8_t precision;
+  uint8_t group;
+  uint8_t nameLength;
+});
+
+enum LogColumnGroup {
+  LOG_GROUP_SLOW,       // logged at the special function interval
+  LOG_GROUP_FAST,       // sticks, pots and channels sampled by the mixer
+  LOG_GROUPS_COUNT
+};
+
+// returns the size in bytes of a column value in a record
+uint8_t logColumnSize(uint8_t type);
+
+// write the file header and start the writer
+const char* logsBinaryOpen();
+
+// queue one record into the RAM buffers (never touches the SD card nor
+// blocks), returns false if the record had to be dropped
+bool logsBinaryWrite();
+
+// sample the fast group columns, called by the mixer task
+void logsSample();
+
+// append the queued samples and flush every full buffer,
+// called periodically by the writer task
+void logsBinaryFlush();
+
+// flush everything, including the partially filled buffer, and close the file
+void logsBinaryClose();
+
+// returns the last error reported by the writer, if any
+const char* logsBinaryError();
+
+// start the low priority writer task
+void logsBinaryStart();
+
+struct LogsBinaryStats {
+  uint32_t records;
+  uint32_t dropped;
+  uint32_t flushes;
+  uint32_t samples;
+  uint32_t samplesDropped;
+};
+
+extern LogsBinaryStats logsBinaryStats;
+
+// helpers shared with the CSV writer (logs.cpp)
+int getSwitchState(uint8_t swtch);
+uint32_t getLogicalSwitchesStates(uint8_t first);
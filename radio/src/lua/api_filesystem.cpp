@@ -23,6 +23,7 @@
 
 #include <cstdio>
 
+#include "audio.h"
 #include "lua_api.h"
 #include "api_filesystem.h"
 
@@ -174,6 +175,7 @@ int luaDelete(lua_State* L)
   const char* filename = luaL_optstring(L, 1, nullptr);
 
   FRESULT res = f_unlink(filename);
+  if (filename) audioFileChanged(filename);
   if (res != FR_OK) {
     TRACE("luaDelete cannot delete file/folder %s\n", filename);
     return 0;
@@ -195,6 +197,10 @@ LROT_BEGIN(etxdir, NULL, 0)
 LROT_END(etxdir, NULL, 0)
 
 extern "C" {
+  void lua__fileWritten(const char* filename) {
+    audioFileChanged(filename);
+  }
+
   LUAMOD_API int luaopen_etxdir(lua_State* L) {
     luaL_rometatable( L, DIR_METATABLE,  LROT_TABLEREF(dir_handle));
     return 0;
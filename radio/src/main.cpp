@@ -535,6 +535,11 @@ void perMain()
 
   if (!usbPlugged() || (getSelectedUsbMode() == USB_UNSELECTED_MODE)) {
     checkEeprom();
+    storagePeriodicHook();
+    // no input for a couple of seconds
+    if (inactivity.counter >= 2) {
+      storageIdleHook();
+    }
     
     #if !defined(SIMU)     // use FreeRTOS software timer if radio firmware
       initLoggingTimer();  // initialize software timer for logging
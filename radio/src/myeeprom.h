@@ -79,6 +79,8 @@
 #define CFN_PLAY_REPEAT_NOSTART        0xFF
 #define CFN_GVAR_MODE(p)               ((p)->all.mode)
 #define CFN_PARAM(p)                   ((p)->all.val)
+#define CFN_LOGS_FAST_RATE(p)          ((p)->all.mode)
+#define SD_LOGS_FAST_RATE_MAX          100  // Hz, sticks and channels sampling rate
 #define CFN_RESET(p)                   ((p)->active=0, (p)->clear.val1=0, (p)->clear.val2=0)
 #define CFN_GVAR_CST_MIN               -GVAR_MAX
 #define CFN_GVAR_CST_MAX               GVAR_MAX
@@ -72,6 +72,7 @@ Clipboard clipboard;
 GlobalData globalData;
 
 uint32_t maxMixerDuration; // microseconds
+uint32_t lastMixerDuration; // microseconds
 
 constexpr uint8_t HEART_TIMER_10MS = 0x01;
 uint8_t heartbeat;
@@ -1055,10 +1056,7 @@ void edgeTxClose(uint8_t shutdown)
   luaClose(&lsScripts);
 #endif
 
-#if defined(SDCARD)
-  logsClose();
-#endif
-
+  // settings are saved before anything else, in case power is cut
   storageFlushCurrentModel();
 
   if (sessionTimer > 0) {
@@ -1071,6 +1069,10 @@ void edgeTxClose(uint8_t shutdown)
   storageDirty(EE_GENERAL);
   storageCheck(true);
 
+#if defined(SDCARD)
+  logsClose();
+#endif
+
   while (IS_PLAYING(ID_PLAY_PROMPT_BASE + AU_BYE)) {
     RTOS_WAIT_MS(10);
   }
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) EdgeTX
+ *
+ * Based on code named
+ *   opentx - https://github.com/opentx/opentx
+ *   th9x - http://code.google.com/p/th9x
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _CHANNELS_PACKER_H_
+#define _CHANNELS_PACKER_H_
+
+#include <inttypes.h>
+
+enum ChannelsBitOrder {
+  CHANNELS_LSB_FIRST, // CRSF, SBUS, Multi
+  CHANNELS_MSB_FIRST,
+};
+
+// Channels of BITS bits packed back to back in a frame. The byte and the
+// shifts of each channel are known at compile time: the channels are
+// unrolled, without any loop or bits counter left in the generated code
+template <unsigned BITS, unsigned COUNT, ChannelsBitOrder ORDER = CHANNELS_LSB_FIRST>
+class ChannelsPacker
+{
+  static_assert(BITS > 0 && BITS <= 16, "Channels are 1 to 16 bits");
+
+ public:
+  static constexpr unsigned FRAME_SIZE = (BITS * COUNT + 7) / 8;
+  static constexpr uint32_t MAX_VALUE = (1u << BITS) - 1;
+
+  // values above MAX_VALUE are truncated, an incomplete last byte is
+  // padded with 0
+  static inline void pack(uint8_t * frame, const uint16_t * values)
+  {
+    Channel<0>::pack(frame, 0, values);
+  }
+
+  static inline void unpack(const uint8_t * frame, uint16_t * values)
+  {
+    Channel<0>::unpack(frame, values);
+  }
+
+ private:
+  template <unsigned I, bool END = (I == COUNT)>
+  struct Channel
+  {
+    // the byte where the channel starts, and the bits of the previous
+    // channels already in it
+    static constexpr unsigned FIRST = I * BITS / 8;
+    static constexpr unsigned PENDING = I * BITS % 8;
+    static constexpr unsigned TOTAL = PENDING + BITS;
+    // the bytes completed with this channel (at most 2), and spanned
+    static constexpr unsigned COMPLETE = TOTAL / 8;
+    static constexpr unsigned SPAN = (TOTAL + 7) / 8;
+
+    static inline void pack(uint8_t * frame, uint32_t bits, const uint16_t * values)
+    {
+      uint32_t value = values[I] & MAX_VALUE;
+      if (ORDER == CHANNELS_LSB_FIRST) {
+        bits |= value << PENDING;
+        if (COMPLETE > 0) frame[FIRST] = bits;
+        if (COMPLETE > 1) frame[FIRST + 1] = bits >> 8;
+        bits >>= 8 * COMPLETE;
+      }
+      else {
+        bits = (bits << BITS) | value;
+        if (COMPLETE > 0) frame[FIRST] = bits >> (COMPLETE > 0 ? TOTAL - 8 : 0);
+        if (COMPLETE > 1) frame[FIRST + 1] = bits >> (COMPLETE > 1 ? TOTAL - 16 : 0);
+        bits &= (1u << (TOTAL % 8)) - 1;
+      }
+      Channel<I + 1>::pack(frame, bits, values);
+    }
+
+    static inline void unpack(const uint8_t * frame, uint16_t * values)
+    {
+      uint32_t word;
+      if (ORDER == CHANNELS_LSB_FIRST) {
+        word = frame[FIRST];
+        if (SPAN > 1) word |= frame[FIRST + 1] << 8;
+        if (SPAN > 2) word |= frame[FIRST + 2] << 16;
+        values[I] = (word >> PENDING) & MAX_VALUE;
+      }
+      else {
+        word = frame[FIRST] << 16;
+        if (SPAN > 1) word |= frame[FIRST + 1] << 8;
+        if (SPAN > 2) word |= frame[FIRST + 2];
+        values[I] = (word >> (24 - TOTAL)) & MAX_VALUE;
+      }
+      Channel<I + 1>::unpack(frame, values);
+    }
+  };
+
+  template <unsigned I>
+  struct Channel<I, true>
+  {
+    static constexpr unsigned PENDING = I * BITS % 8;
+
+    static inline void pack(uint8_t * frame, uint32_t bits, const uint16_t *)
+    {
+      if (PENDING > 0) {
+        frame[FRAME_SIZE - 1] = ORDER == CHANNELS_LSB_FIRST ? bits : bits << (8 - PENDING);
+      }
+    }
+
+    static inline void unpack(const uint8_t *, uint16_t *)
+    {
+    }
+  };
+};
+
+#endif // _CHANNELS_PACKER_H_
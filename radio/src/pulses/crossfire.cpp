@@ -30,6 +30,7 @@
 #include "hal/module_port.h"
 
 #include "crossfire.h"
+#include "channels_packer.h"
 #include "telemetry/crossfire.h"
 
 #define CROSSFIRE_CH_BITS           11
@@ -42,6 +43,8 @@
 
 #define MIN_FRAME_LEN 3
 
+typedef ChannelsPacker<CROSSFIRE_CH_BITS, CROSSFIRE_CHANNELS_COUNT> CrossfireChannelsPacker;
+
 uint8_t createCrossfireModelIDFrame(uint8_t moduleIdx, uint8_t * frame)
 {
   uint8_t * buf = frame;
@@ -66,18 +69,12 @@ uint8_t createCrossfireChannelsFrame(uint8_t * frame, int16_t * pulses)
   *buf++ = 24; // 1(ID) + 22 + 1(CRC)
   uint8_t * crc_start = buf;
   *buf++ = CHANNELS_ID;
-  uint32_t bits = 0;
-  uint8_t bitsavailable = 0;
+  uint16_t values[CROSSFIRE_CHANNELS_COUNT];
   for (int i=0; i<CROSSFIRE_CHANNELS_COUNT; i++) {
-    uint32_t val = limit(0, CROSSFIRE_CENTER + (CROSSFIRE_CENTER_CH_OFFSET(i) * 4) / 5 + (pulses[i] * 4) / 5, 2 * CROSSFIRE_CENTER);
-    bits |= val << bitsavailable;
-    bitsavailable += CROSSFIRE_CH_BITS;
-    while (bitsavailable >= 8) {
-      *buf++ = bits;
-      bits >>= 8;
-      bitsavailable -= 8;
-    }
+    values[i] = limit(0, CROSSFIRE_CENTER + (CROSSFIRE_CENTER_CH_OFFSET(i) * 4) / 5 + (pulses[i] * 4) / 5, 2 * CROSSFIRE_CENTER);
   }
+  CrossfireChannelsPacker::pack(buf, values);
+  buf += CrossfireChannelsPacker::FRAME_SIZE;
   *buf++ = crc8(crc_start, 23);
   return buf - frame;
 }
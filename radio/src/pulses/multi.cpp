@@ -21,6 +21,7 @@
 
 #include "opentx.h"
 #include "multi.h"
+#include "channels_packer.h"
 
 #include "io/multi_protolist.h"
 #include "telemetry/multi.h"
@@ -37,6 +38,8 @@
 #define MULTI_CHANS                         16
 #define MULTI_CHAN_BITS                     11
 
+typedef ChannelsPacker<MULTI_CHAN_BITS, MULTI_CHANS> MultiChannelsPacker;
+
 #define MULTI_NORMAL   0x00
 #define MULTI_FAILSAFE 0x01
 #define MULTI_DATA     0x02
@@ -81,8 +84,7 @@ static void updateMultiSync(uint8_t module)
 
 static void sendFailsafeChannels(uint8_t*& p_buf, uint8_t module)
 {
-  uint32_t bits = 0;
-  uint8_t bitsavailable = 0;
+  uint16_t values[MULTI_CHANS];
 
   for (int i = 0; i < MULTI_CHANS; i++) {
     int16_t failsafeValue = g_model.failsafeChannels[i];
@@ -102,14 +104,11 @@ static void sendFailsafeChannels(uint8_t*& p_buf, uint8_t module)
       pulseValue = limit(1, (failsafeValue * 800 / 1000) + 1024, 2046);
     }
 
-    bits |= pulseValue << bitsavailable;
-    bitsavailable += MULTI_CHAN_BITS;
-    while (bitsavailable >= 8) {
-      sendMulti(p_buf, (uint8_t) (bits & 0xff));
-      bits >>= 8;
-      bitsavailable -= 8;
-    }
+    values[i] = pulseValue;
   }
+
+  MultiChannelsPacker::pack(p_buf, values);
+  p_buf += MultiChannelsPacker::FRAME_SIZE;
 }
 
 static void setupPulsesMulti(uint8_t*& p_buf, uint8_t module)
@@ -292,8 +291,7 @@ const etx_proto_driver_t MultiDriver = {
 
 static void sendChannels(uint8_t*& p_buf, uint8_t module)
 {
-  uint32_t bits = 0;
-  uint8_t bitsavailable = 0;
+  uint16_t values[MULTI_CHANS];
 
   // byte 4-25, channels 0..2047
   // Range for pulses (channelsOutputs) is [-1024:+1024] for [-100%;100%]
@@ -304,16 +302,11 @@ static void sendChannels(uint8_t*& p_buf, uint8_t module)
 
     // Scale to 80%
     value = value * 800 / 1000 + 1024;
-    value = limit(0, value, 2047);
-
-    bits |= value << bitsavailable;
-    bitsavailable += MULTI_CHAN_BITS;
-    while (bitsavailable >= 8) {
-      sendMulti(p_buf, (uint8_t) (bits & 0xff));
-      bits >>= 8;
-      bitsavailable -= 8;
-    }
+    values[i] = limit(0, value, 2047);
   }
+
+  MultiChannelsPacker::pack(p_buf, values);
+  p_buf += MultiChannelsPacker::FRAME_SIZE;
 }
 
 void sendFrameProtocolHeader(uint8_t*& p_buf, uint8_t module, bool failsafe)
@@ -557,6 +557,7 @@ void sdDone()
     f_close(&g_bluetoothFile);
 #endif
 
+    storagePreUnmountHook();
     f_mount(nullptr, "", 0); // unmount SD
   }
 }
@@ -75,6 +75,8 @@ const char LABELSLIST_YAML_PATH[] = MODELS_PATH PATH_SEPARATOR LABELS_FILENAME;
 const char RADIO_SETTINGS_YAML_PATH[] = RADIO_PATH PATH_SEPARATOR "radio.yml";
 const char RADIO_SETTINGS_TMPFILE_YAML_PATH[] = RADIO_PATH PATH_SEPARATOR "radio_new.yml";
 const char RADIO_SETTINGS_ERRORFILE_YAML_PATH[] = RADIO_PATH PATH_SEPARATOR "radio_error.yml";
+#define MODELS_CACHE_PATH   RADIO_PATH PATH_SEPARATOR "CACHE"
+#define MODELS_CACHE_EXT    ".bin"
 
 const char YAMLFILE_CHECKSUM_TAG_NAME[] = "checksum";
 #endif
@@ -121,10 +123,32 @@ const char YAMLFILE_CHECKSUM_TAG_NAME[] = "checksum";
   strcat(&filename[sizeof(path)], ext)
 
 extern uint8_t logDelay100ms;
+#if defined(LOGS_BINARY)
+extern uint8_t logFastRate;  // Hz, 0 = sticks and channels logged with sensors
+#endif
 void logsInit();
 void logsClose();
 void logsWrite();
 
+// Log files are preallocated in large extents, these must surround
+// every write to g_oLogFile
+FRESULT logsReserve(UINT size);
+void logsWritten(uint32_t startMs);
+void logsTruncate();
+
+// write latency histogram: bucket n counts the writes faster than 2^n ms,
+// the last one all the slower ones
+#define LOGS_LATENCY_BUCKETS  10
+
+struct LogsWriteStats {
+  uint32_t latency[LOGS_LATENCY_BUCKETS];
+  uint32_t maxLatency;  // ms
+  uint16_t extents;
+  uint16_t syncs;
+};
+
+extern LogsWriteStats logsWriteStats;
+
 void sdInit();
 void sdMount();
 void sdDone();
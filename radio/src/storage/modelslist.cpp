@@ -136,7 +136,8 @@ ModelsVector ModelMap::getUnlabeledModels()
 {
   ModelsVector unlabeledModels;
   for (auto model : modelslist) {
-    if (modelslabels.getLabelsByModel(model).size() == 0)
+    auto it = modelLabels.lower_bound(std::make_pair(model, (uint16_t)0));
+    if (it == modelLabels.end() || it->first != model)
       unlabeledModels.emplace_back(model);
   }
   sortModelsBy(unlabeledModels, _sortOrder);
@@ -167,8 +168,9 @@ ModelsVector ModelMap::getModelsByLabel(const std::string &lbl)
   int index = getIndexByLabel(lbl);
   if (index < 0) return ModelsVector();
   ModelsVector rv;
-  for (auto it = begin(); it != end(); ++it) {
-    if (it->first == index) rv.push_back(it->second);
+  auto range = equal_range(index);
+  for (auto it = range.first; it != range.second; ++it) {
+    rv.push_back(it->second);
   }
   sortModelsBy(rv, _sortOrder);
   return rv;
@@ -193,10 +195,13 @@ ModelsVector ModelMap::getModelsByLabels(const LabelsVector &lbls)
     if (index >= 0) idxvect.push_back(index);
   }
 
+  // a model in several of the labels is only returned once
+  std::set<ModelCell *> found;
   ModelsVector rv;
-  for (auto it = begin(); it != end(); ++it) {
-    for (auto idx : idxvect) {
-      if (it->first == idx) rv.push_back(it->second);
+  for (auto idx : idxvect) {
+    auto range = equal_range(idx);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (found.insert(it->second).second) rv.push_back(it->second);
     }
   }
 
@@ -225,21 +230,29 @@ ModelsVector ModelMap::getModelsInLabels(const LabelsVector &lbls)
   if (lbls.size() == 1 && lbls.at(0) == STR_UNLABELEDMODEL)
     return getUnlabeledModels();
 
-  ModelsVector rv;
+  std::vector<uint16_t> idxvect;
+  for (const auto &lbl : lbls) {
+    if (lbl == STR_UNLABELEDMODEL)  // If requesting unlabeled model ignore it
+      break;
+    int index = getIndexByLabel(lbl);
+    if (index < 0) return ModelsVector();  // no model can have it
+    idxvect.push_back(index);
+  }
 
-  for (const auto &mdl : modelslist) {
+  if (idxvect.size() == 0) return getAllModels();
+
+  // Models of the first label having all the other ones
+  ModelsVector rv;
+  auto range = equal_range(idxvect.front());
+  for (auto it = range.first; it != range.second; ++it) {
     bool hasAllLabels = true;
-    LabelsVector mdllables = getLabelsByModel(mdl);
-    for (const auto &lbl : lbls) {
-      if (lbl == STR_UNLABELEDMODEL)  // If requesting unlabeled model ignore it
-        break;
-      if (std::find(mdllables.begin(), mdllables.end(), lbl) ==
-          mdllables.end()) {
+    for (auto idx : idxvect) {
+      if (!hasLabel(it->second, idx)) {
         hasAllLabels = false;
         break;
       }
     }
-    if (hasAllLabels) rv.push_back(mdl);
+    if (hasAllLabels) rv.push_back(it->second);
   }
 
   sortModelsBy(rv, _sortOrder);
@@ -257,10 +270,9 @@ LabelsVector ModelMap::getLabelsByModel(ModelCell *mdl)
 {
   if (mdl == nullptr) return LabelsVector();
   LabelsVector rv;
-  for (auto it = begin(); it != end(); ++it) {
-    if (it->second == mdl) {
-      rv.push_back(getLabelByIndex(it->first));
-    }
+  for (auto it = modelLabels.lower_bound(std::make_pair(mdl, (uint16_t)0));
+       it != modelLabels.end() && it->first == mdl; ++it) {
+    rv.push_back(getLabelByIndex(it->second));
   }
   return rv;
 }
@@ -299,11 +311,8 @@ std::map<std::string, bool> ModelMap::getSelectedLabels(ModelCell *cell)
 
 bool ModelMap::isLabelSelected(const std::string &label, ModelCell *cell)
 {
-  auto lbm = getLabelsByModel(cell);
-  if (std::find(lbm.begin(), lbm.end(), label) == lbm.end()) {
-    return false;
-  }
-  return true;
+  int index = getIndexByLabel(label);
+  return index >= 0 && hasLabel(cell, index);
 }
 
 /**
@@ -347,6 +356,7 @@ int ModelMap::addLabel(std::string lbl)
   int ind = getIndexByLabel(lbl);
   if (ind < 0) {
     labels.push_back(lbl);
+    labelIndexes.emplace(lbl, labels.size() - 1);
     setDirty();
     TRACE_LABELS("Added a label %s", lbl.c_str());
     return labels.size() - 1;
@@ -377,13 +387,40 @@ bool ModelMap::addLabelToModel(const std::string &lbl, ModelCell *cell,
 
   setDirty();
   int labelindex = addLabel(lbl);
-  insert(std::pair<int, ModelCell *>(labelindex, cell));
+  if (labelindex < 0) return true;
+  if (hasLabel(cell, labelindex)) return false;
+  insertLabel(labelindex, cell);
 
   if (update) updateModelFile(cell);  // Write labels into model
 
   return false;
 }
 
+/**
+ * @brief Adds a model to a label, in the map and the reverse index
+ *
+ * @param index Label index
+ * @param cell Model
+ */
+
+void ModelMap::insertLabel(uint16_t index, ModelCell *cell)
+{
+  insert(std::make_pair(index, cell));
+  modelLabels.insert(std::make_pair(cell, index));
+}
+
+/**
+ * @brief Rebuilds the label name index after 'labels' was changed
+ */
+
+void ModelMap::indexLabels()
+{
+  labelIndexes.clear();
+  for (uint16_t i = 0; i < labels.size(); i++) {
+    labelIndexes.emplace(labels[i], i);
+  }
+}
+
 /**
  * @brief Adds a label to the filter, used in yaml_labelslist on load
  *
@@ -524,12 +561,17 @@ bool ModelMap::removeLabelFromModel(const std::string &label, ModelCell *cell,
   if (lblind < 0) return true;
   bool rv = true;
   // Erase items that match in the map
-  for (ModelMap::const_iterator itr = cbegin(); itr != cend();) {
-    itr = (itr->first == lblind && itr->second == cell) ? erase(itr)
-                                                        : std::next(itr);
-    setDirty();
-    rv = false;
+  auto range = equal_range(lblind);
+  for (auto itr = range.first; itr != range.second;) {
+    if (itr->second == cell) {
+      itr = erase(itr);
+      setDirty();
+      rv = false;
+    } else {
+      itr = std::next(itr);
+    }
   }
+  modelLabels.erase(std::make_pair(cell, (uint16_t)lblind));
 
   if (update) updateModelFile(cell);  // Write labels into model
 
@@ -560,6 +602,7 @@ bool ModelMap::removeLabel(
       renameFault = false;
     }
   }
+  indexLabels();
 
   // If no more labels, add a favorite
   if (!renameFault && getLabels().size() == 0) {
@@ -591,20 +634,31 @@ bool ModelMap::moveLabelTo(unsigned curind, unsigned newind)
   if (labels.at(curind) == "") return true;
 
   std::swap(labels[curind], labels[newind]);
+  indexLabels();
 
-  ModelMap newmap;
-  newmap.labels = labels;
+  std::vector<std::pair<uint16_t, ModelCell *>> entries(begin(), end());
+  std::multimap<uint16_t, ModelCell *>::clear();
+  modelLabels.clear();
 
-  for (auto &mm : modelslabels) {
+  for (auto &mm : entries) {
     uint16_t ind = mm.first;
     if (ind == curind)
       ind = newind;
     else if (ind == newind)
       ind = curind;
-    newmap.insert(std::make_pair(ind, mm.second));
+    insertLabel(ind, mm.second);
   }
 
-  modelslabels = newmap;
+  // the filter follows the labels
+  std::set<uint32_t> newfilt;
+  for (auto ind : filtlbls) {
+    if (ind == curind)
+      ind = newind;
+    else if (ind == newind)
+      ind = curind;
+    newfilt.insert(ind);
+  }
+  filtlbls = newfilt;
 
   modelslist.save(labels);
   setDirty();
@@ -720,6 +774,7 @@ bool ModelMap::renameLabel(const std::string &from, std::string to,
       setDirty(true);
     }
   }
+  indexLabels();
 
   // Make sure to leave at 100, to kill rename dialog
   if (progress != nullptr) progress("", 100);
@@ -775,14 +830,19 @@ bool ModelMap::removeModels(ModelCell *cell)
 {
   bool rv = true;
   // Erase items that match in the map
-  for (ModelMap::const_iterator itr = cbegin(); itr != cend();) {
-    if (itr->second == cell) {
-      itr = erase(itr);
-      setDirty();
-      rv = false;
-    } else {
-      itr = std::next(itr);
+  for (auto it = modelLabels.lower_bound(std::make_pair(cell, (uint16_t)0));
+       it != modelLabels.end() && it->first == cell;) {
+    auto range = equal_range(it->second);
+    for (auto itr = range.first; itr != range.second;) {
+      if (itr->second == cell) {
+        itr = erase(itr);
+        setDirty();
+        rv = false;
+      } else {
+        itr = std::next(itr);
+      }
     }
+    it = modelLabels.erase(it);
   }
   return rv;
 }
@@ -1035,16 +1095,14 @@ bool ModelsList::loadYaml()
       }
 
       // Store hash & filename
-      filedat cf;
+      filedat &cf = fileHashInfo[finfo.fname];
       FILInfoToHexStr(cf.hash, &finfo);
-      cf.name = finfo.fname;
       cf.celladded = false;
       if (!strncmp(finfo.fname, g_eeGeneral.currModelFilename,
                    LEN_MODEL_FILENAME))
         cf.curmodel = true;
       else
         cf.curmodel = false;
-      fileHashInfo.push_back(cf);
       TRACE_LABELS("File - %s \r\n  HASH - %s - CM: %s", finfo.fname, cf.hash,
                    cf.curmodel ? "Y" : "N");
     }
@@ -1054,18 +1112,20 @@ bool ModelsList::loadYaml()
   // Check if models.yml exists
   // Any files found above that are not listed in the file will be moved into
   // /MDOELS/UNUSED and removed from the discovered file hash list
-  char line[LEN_MODELS_IDX_LINE + 1];
   FILINFO fno;
-  FRESULT result;
   bool foundInModels = f_stat(MODELSLIST_YAML_PATH, &fno) == FR_OK;
   bool foundInRadio = f_stat(FALLBACK_MODELSLIST_YAML_PATH, &fno) == FR_OK;
 
+  std::vector<std::string> modfiles;
+  const char* error = nullptr;
   if(foundInModels) { // Default to /Models copy
-    result = f_open(&file, MODELSLIST_YAML_PATH, FA_OPEN_EXISTING | FA_READ);
+    error = readYamlFile(MODELSLIST_YAML_PATH, get_modelslist_parser_calls(),
+                         get_modelslist_iter(&modfiles), nullptr);
   } else if (foundInRadio) {
-    result = f_open(&file, FALLBACK_MODELSLIST_YAML_PATH, FA_OPEN_EXISTING | FA_READ);
+    error = readYamlFile(FALLBACK_MODELSLIST_YAML_PATH, get_modelslist_parser_calls(),
+                         get_modelslist_iter(&modfiles), nullptr);
   }
-  if((foundInModels || foundInRadio) && result == FR_OK) {
+  if((foundInModels || foundInRadio) && !error) {
     // Create /Models/Unused if it doesn't exist
     bool moveRequired = false;
     DIR unusedFolder;
@@ -1074,43 +1134,25 @@ bool ModelsList::loadYaml()
       if (result == FR_NO_PATH) result = f_mkdir(UNUSED_MODELS_PATH);
       if (result != FR_OK) {
         TRACE("Unable to create unused models folder");
-        f_close(&file);
         return false;
       }
     } else f_closedir(&unusedFolder);
 
-    YamlParser ymp;
-    std::vector<std::string> modfiles;
-    void *ctx = get_modelslist_iter(&modfiles);
-    ymp.init(get_modelslist_parser_calls(), ctx);
-    UINT bytes_read = 0;
-    while (f_read(&file, line, sizeof(line), &bytes_read) == FR_OK) {
-      if (bytes_read == 0) break;
-      if (f_eof(&file)) ymp.set_eof();
-      if (ymp.parse(line, bytes_read) != YamlParser::CONTINUE_PARSING) break;
-    }
-    f_close(&file);
-
     // Loop through file hases, move any files found that don't exists to /unused
-    std::vector<filedat> newFileHash;
-    for(const auto &fhas: fileHashInfo) {
-      bool found = false;
-      for(const auto &file : modfiles) {
-        if (file == fhas.name) {
-          TRACE_LABELS("Found file %s in models.yml.. OK!", file);
-          found = true;
-          break;
-        }
-      }
-      if(!found) {
+    std::set<std::string> listed(modfiles.begin(), modfiles.end());
+    for (auto fhas = fileHashInfo.begin(); fhas != fileHashInfo.end();) {
+      const std::string &name = fhas->first;
+      if (listed.find(name) != listed.end()) {
+        TRACE_LABELS("Found file %s in models.yml.. OK!", name.c_str());
+        ++fhas;  // File exists, keep it
+      } else {
         moveRequired = true;
-        TRACE_LABELS("Model %s not in models.yml, moving to /UNUSED", fhas.name.c_str());
+        TRACE_LABELS("Model %s not in models.yml, moving to /UNUSED", name.c_str());
         // Move model into unused folder.
-        const char *warning = sdMoveFile(fhas.name.c_str(), MODELS_PATH, fhas.name.c_str(), UNUSED_MODELS_PATH);
+        const char *warning = sdMoveFile(name.c_str(), MODELS_PATH, name.c_str(), UNUSED_MODELS_PATH);
         if(warning)
           POPUP_WARNING(warning);
-      } else {
-        newFileHash.push_back(fhas); // File exists, keep it
+        fhas = fileHashInfo.erase(fhas);
       }
     }
 
@@ -1125,7 +1167,6 @@ bool ModelsList::loadYaml()
         POPUP_WARNING(warning);
     }
     if(moveRequired) {
-      fileHashInfo = newFileHash; // Update the new file list
       POPUP_WARNING(TR_MODELS_MOVED "\n" UNUSED_MODELS_PATH, "\n" TR_PRESS_ANY_KEY_TO_SKIP);
     }
   }
@@ -1137,19 +1178,8 @@ bool ModelsList::loadYaml()
 #endif
 
   // Scan labels.yml
-  result = f_open(&file, LABELSLIST_YAML_PATH, FA_OPEN_EXISTING | FA_READ);
-  if (result == FR_OK) {
-    YamlParser yp;
-    void *ctx = get_labelslist_iter();
-    yp.init(get_labelslist_parser_calls(), ctx);
-    UINT bytes_read = 0;
-    while (f_read(&file, line, sizeof(line), &bytes_read) == FR_OK) {
-      if (bytes_read == 0) break;
-      if (f_eof(&file)) yp.set_eof();
-      if (yp.parse(line, bytes_read) != YamlParser::CONTINUE_PARSING) break;
-    }
-    f_close(&file);
-  }
+  readYamlFile(LABELSLIST_YAML_PATH, get_labelslist_parser_calls(),
+               get_labelslist_iter(), nullptr);
 
 #if defined(DEBUG_TIMERS)
   DEBUG_TIMER_SAMPLE(debugTimerYamlScan);
@@ -1158,12 +1188,13 @@ bool ModelsList::loadYaml()
 #endif
 
   // Add modelcells for any remaining models that weren't in labels.yml
-  for (auto &filehash : fileHashInfo) {
+  for (auto &entry : fileHashInfo) {
     ModelCell *model = NULL;
+    filedat &filehash = entry.second;
     if (filehash.celladded == false) {
       TRACE_LABELS("  Created a modelcell for %s, not in labels.yml",
-                   filehash.name.c_str());
-      model = new ModelCell(filehash.name.c_str());
+                   entry.first.c_str());
+      model = new ModelCell(entry.first.c_str());
       strncpy(model->modelFinfoHash, filehash.hash, FILE_HASH_LENGTH);
       model->modelFinfoHash[FILE_HASH_LENGTH] = '\0';
       modelslist.push_back(model);
@@ -1366,6 +1397,15 @@ void ModelsList::updateCurrentModelCell()
     currentModel->modelFilename[LEN_MODEL_FILENAME] = '\0';
     currentModel->setModelName(g_model.header.name);
     currentModel->setRfData(&g_model);
+
+    // Keep the hash in sync with the saved file, so that labels.yml stays
+    // valid and the model is not read again on next boot
+    char path[256];
+    getModelPath(path, currentModel->modelFilename);
+    FILINFO fno;
+    if (f_stat(path, &fno) == FR_OK)
+      FILInfoToHexStr(currentModel->modelFinfoHash, &fno);
+
     modelslabels.setDirty();
   } else {
     TRACE("ModelList Error - No Current Model");
@@ -1461,6 +1501,7 @@ bool ModelsList::removeModel(ModelCell *model)
     TRACE("Labels: Unable to move file");
     return true;
   }
+  removeModelCache(model->modelFilename);
 
   // Free memory
   delete(model);
@@ -189,15 +189,25 @@ class ModelMap : protected std::multimap<uint16_t, ModelCell *>
   {
     _isDirty = true;
     labels.clear();
+    labelIndexes.clear();
+    modelLabels.clear();
     std::multimap<uint16_t, ModelCell *>::clear();
   }
 
   int getIndexByLabel(const std::string &str)
   {
-    auto a = std::find(labels.begin(), labels.end(), str);
-    return a == labels.end() ? -1 : a - labels.begin();
+    auto a = labelIndexes.find(str);
+    return a == labelIndexes.end() ? -1 : a->second;
   }
 
+  bool hasLabel(ModelCell *cell, uint16_t index)
+  {
+    return modelLabels.find(std::make_pair(cell, index)) != modelLabels.end();
+  }
+
+  void insertLabel(uint16_t index, ModelCell *cell);
+  void indexLabels();
+
   std::string getLabelByIndex(uint16_t index)
   {
     if (index < (uint16_t)labels.size())
@@ -210,6 +220,13 @@ class ModelMap : protected std::multimap<uint16_t, ModelCell *>
 
  private:
   LabelsVector labels;  // Storage space for discovered labels
+
+  // Indexes kept in sync with the map and 'labels', so that the GUI
+  // filters do not have to walk every model:
+  //  - label name -> index in 'labels' (first one if duplicated)
+  //  - model -> label indexes, the reverse of the map, sorted
+  std::map<std::string, uint16_t> labelIndexes;
+  std::set<std::pair<ModelCell *, uint16_t>> modelLabels;
 };
 
 class ModelsList : public ModelsVector
@@ -259,12 +276,12 @@ class ModelsList : public ModelsVector
   uint8_t findNextUnusedModelId(uint8_t moduleIdx);
 
   typedef struct _filedat {
-    std::string name;
     char hash[FILE_HASH_LENGTH + 1];
     bool curmodel = false;
     bool celladded = false;
   } filedat;
-  std::vector<filedat> fileHashInfo;
+  // files found in MODELS_PATH, by file name
+  std::map<std::string, filedat> fileHashInfo;
 
  protected:
   FIL file;
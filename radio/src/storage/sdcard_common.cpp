@@ -78,12 +78,19 @@ void storageCheck(bool immediately)
   // Don't write anything to SD card if in EM
   if (globalData.unexpectedShutdown) return;
 
-  if (storageDirtyMsk & EE_GENERAL) {
-    TRACE("eeprom write general");
-    storageDirtyMsk &= ~EE_GENERAL;
-    const char * error = writeGeneralSettings();
+  uint8_t msk = storageDirtyMsk;
+
+  // The model goes first: the labels list is updated from it, and
+  // on shutdown the radio settings clear 'unexpectedShutdown' last
+  if (storageDirtyMsk & EE_MODEL) {
+    TRACE("eeprom write model");
+    storageDirtyMsk &= ~EE_MODEL;
+    const char * error = writeModel();
+#if defined(STORAGE_MODELSLIST)
+    modelslist.updateCurrentModelCell();
+#endif
     if (error) {
-      TRACE("writeGeneralSettings error=%s", error);
+      TRACE("writeModel error=%s", error);
     }
   }
 
@@ -98,17 +105,16 @@ void storageCheck(bool immediately)
   }
 #endif
 
-  if (storageDirtyMsk & EE_MODEL) {
-    TRACE("eeprom write model");
-    storageDirtyMsk &= ~EE_MODEL;
-    const char * error = writeModel();
-#if defined(STORAGE_MODELSLIST)
-    modelslist.updateCurrentModelCell();
-#endif
+  if (storageDirtyMsk & EE_GENERAL) {
+    TRACE("eeprom write general");
+    storageDirtyMsk &= ~EE_GENERAL;
+    const char * error = writeGeneralSettings();
     if (error) {
-      TRACE("writeModel error=%s", error);
+      TRACE("writeGeneralSettings error=%s", error);
     }
   }
+
+  storageWritten(msk, immediately);
 }
 
 #if defined(STORAGE_MODELSLIST)
@@ -23,6 +23,7 @@
 #include "myeeprom.h"
 #include "opentx.h"
 #include "opentx_helpers.h"
+#include "fw_version.h"
 #include "storage.h"
 #include "sdcard_common.h"
 #include "sdcard_raw.h"
@@ -40,30 +41,98 @@
  #include "storage/eeprom_rlc.h"
 #endif
 
-const char * readYamlFile(const char* fullpath, const YamlParserCalls* calls, void* parser_ctx, ChecksumResult* checksum_result)
+// YAML files are read and written in whole sectors through a shared
+// buffer: when the file position is sector aligned FatFs transfers
+// straight from/to it, instead of going through the file object sector
+// buffer, so it must be DMA capable.
+// YAML files are only read and written from the UI task.
+#if defined(COLORLCD)
+  #define YAML_BUFFER_SIZE  (8 * 512)
+#else
+  #define YAML_BUFFER_SIZE  512
+#endif
+
+static char yamlBuffer[YAML_BUFFER_SIZE] __DMA;
+
+// YAML files are written next to their final path and renamed once
+// complete (see writeFileYaml())
+#define YAML_TMP_EXT       ".tmp"
+#define LEN_YAML_PATH_MAX  (256 + sizeof(YAML_TMP_EXT))
+
+// returns false if the path is too long
+static bool getYamlTmpPath(char* tmpPath, const char* path)
+{
+  size_t len = strlen(path);
+  if (len + sizeof(YAML_TMP_EXT) > LEN_YAML_PATH_MAX)
+    return false;
+
+  memcpy(tmpPath, path, len);
+  strcpy(tmpPath + len, YAML_TMP_EXT);
+  return true;
+}
+
+// a power loss between unlinking a file and renaming its new version
+// leaves only the latter
+static FRESULT recoverYamlFile(const char* path)
+{
+  char tmpPath[LEN_YAML_PATH_MAX];
+  if (!getYamlTmpPath(tmpPath, path))
+    return FR_NO_FILE;
+
+  FRESULT result = f_rename(tmpPath, path);
+  if (result == FR_OK) {
+    TRACE("YAML file recovered: %s", path);
+  }
+  return result;
+}
+
+// size and CRC of a YAML file, gathered while it is read
+struct YamlFileSum {
+    uint32_t size;
+    uint16_t crc;
+    bool     complete;  // the whole file was read
+};
+
+static const char* parseYamlFile(const char* fullpath, const YamlParserCalls* calls, void* parser_ctx,
+                                 ChecksumResult* checksum_result, YamlFileSum* sum)
 {
     FIL  file;
     UINT bytes_read;
     UINT total_bytes = 0;
 
+    DEBUG_TIMER_START(debugTimerYamlRead);
+
     FRESULT result = f_open(&file, fullpath, FA_OPEN_EXISTING | FA_READ);
+    if (result == FR_NO_FILE && recoverYamlFile(fullpath) == FR_OK) {
+        result = f_open(&file, fullpath, FA_OPEN_EXISTING | FA_READ);
+    }
     if (result != FR_OK) {
         return SDCARD_ERROR(result);
     }
 
-    YamlParser yp; //TODO: move to re-usable buffer
+    YamlParser yp;
     yp.init(calls, parser_ctx);
 
     uint16_t calculated_checksum = 0xFFFF;
     uint16_t file_checksum = 0;
 
+    if (sum != NULL) {
+      sum->crc = 0;
+      sum->complete = false;
+    }
+
     bool first_block = true;
-    char buffer[32];
-    while (f_read(&file, buffer, sizeof(buffer)-1, &bytes_read) == FR_OK) {
+    char* buffer = yamlBuffer;
+    while (f_read(&file, buffer, YAML_BUFFER_SIZE, &bytes_read) == FR_OK) {
       if (bytes_read == 0)  // EOF
         break;
       total_bytes += bytes_read;
 
+      // before the checksum line below is altered
+      if (sum != NULL) {
+        sum->crc = crc16(CRC_1021, (const uint8_t *)buffer, bytes_read, sum->crc);
+      }
+
       uint16_t skip = 0;
       if(first_block) {
         // Get the 'checksum' value and skip from further YAML processing
@@ -76,13 +145,14 @@ const char * readYamlFile(const char* fullpath, const YamlParserCalls* calls, vo
           char* endPos = startPos;
           // Advance through the value
           while((*endPos != '\r') && (*endPos != '\n')) {
-            if (endPos > buffer + bytes_read) {
+            if (endPos >= buffer + bytes_read - 1) {
+              f_close(&file);
               return SDCARD_ERROR(	FR_INT_ERR );
             }
             endPos++;
           }
           // Skip trailing newline
-          while((*endPos == '\r') || (*endPos == '\n')) {
+          while((endPos < buffer + bytes_read) && ((*endPos == '\r') || (*endPos == '\n'))) {
             *endPos = 0;
             endPos++;
           }
@@ -101,8 +171,14 @@ const char * readYamlFile(const char* fullpath, const YamlParserCalls* calls, vo
       if (yp.parse(buffer + skip, bytes_read - skip) != YamlParser::CONTINUE_PARSING)
         break;
     }
+    if (sum != NULL) {
+      sum->size = total_bytes;
+      sum->complete = total_bytes == f_size(&file);
+    }
     f_close(&file);
 
+    DEBUG_TIMER_STOP(debugTimerYamlRead);
+
     if (checksum_result != NULL) {
       // Special case to handle "old" files with no checksum field
       // 25 was arbitrarily chosen as the minimum realistic file size
@@ -122,6 +198,11 @@ const char * readYamlFile(const char* fullpath, const YamlParserCalls* calls, vo
     return NULL;
 }
 
+const char * readYamlFile(const char* fullpath, const YamlParserCalls* calls, void* parser_ctx, ChecksumResult* checksum_result)
+{
+    return parseYamlFile(fullpath, calls, parser_ctx, checksum_result, NULL);
+}
+
 //
 // SDCARD storage interface
 //
@@ -203,6 +284,7 @@ const char * loadRadioSettings()
 struct yaml_checksummer_ctx {
     FRESULT result;
     uint16_t checksum;
+    uint32_t size;
     bool checksum_invalid;
 };
 
@@ -211,10 +293,12 @@ static bool yaml_checksummer(void* opaque, const char* str, size_t len)
     yaml_checksummer_ctx* ctx = (yaml_checksummer_ctx*)opaque;
 
     ctx->checksum = crc16(0, (const uint8_t *) str, len, ctx->checksum);
+    ctx->size += len;
     return true;
 }
 
-bool YamlFileChecksum(const YamlNode* root_node, uint8_t* data, uint16_t* checksum)
+static bool yamlGeneratedChecksum(const YamlNode* root_node, uint8_t* data,
+                                  uint16_t* checksum, uint32_t* size)
 {
     YamlTreeWalker tree;
     tree.reset(root_node, data);
@@ -222,6 +306,7 @@ bool YamlFileChecksum(const YamlNode* root_node, uint8_t* data, uint16_t* checks
     yaml_checksummer_ctx ctx;
     ctx.result = FR_OK;
     ctx.checksum = 0xFFFF;
+    ctx.size = 0;
     ctx.checksum_invalid = false;
 
     if (!tree.generate(yaml_checksummer, &ctx)) {
@@ -234,30 +319,97 @@ bool YamlFileChecksum(const YamlNode* root_node, uint8_t* data, uint16_t* checks
     if(checksum != NULL) {
       *checksum = ctx.checksum;
     }
+    if(size != NULL) {
+      *size = ctx.size;
+    }
 
     return true;
 }
 
+bool YamlFileChecksum(const YamlNode* root_node, uint8_t* data, uint16_t* checksum)
+{
+    return yamlGeneratedChecksum(root_node, data, checksum, NULL);
+}
+
+// returns true if the file holds exactly 'size' bytes of YAML matching
+// 'checksum', not counting its 'checksum' line
+static bool yamlFileUnchanged(const char* path, uint16_t checksum, uint32_t size)
+{
+    FIL file;
+    if (f_open(&file, path, FA_OPEN_EXISTING | FA_READ) != FR_OK)
+        return false;
+
+    uint16_t calculated_checksum = 0xFFFF;
+    uint32_t total_bytes = 0;
+    bool first_block = true;
+    UINT bytes_read;
 
+    while (f_read(&file, yamlBuffer, YAML_BUFFER_SIZE, &bytes_read) == FR_OK &&
+           bytes_read > 0) {
+      UINT skip = 0;
+      if (first_block) {
+        first_block = false;
+        if (strncmp(yamlBuffer, "checksum: ", 10) == 0) {
+          const char* eol = (const char*)memchr(yamlBuffer, '\n', bytes_read);
+          if (!eol) break;
+          skip = eol + 1 - yamlBuffer;
+        }
+        // a different size cannot match, no need to read any further
+        if (f_size(&file) - skip != size) break;
+      }
+
+      calculated_checksum = crc16(0, (const uint8_t*)yamlBuffer + skip,
+                                  bytes_read - skip, calculated_checksum);
+      total_bytes += bytes_read - skip;
+    }
+    f_close(&file);
+
+    return total_bytes == size && calculated_checksum == checksum;
+}
+
+// output is gathered into yamlBuffer and written in whole sectors
 struct yaml_writer_ctx {
     FIL*    file;
     FRESULT result;
+    UINT    buffered;
 };
 
-static bool yaml_writer(void* opaque, const char* str, size_t len)
+static bool yaml_writer_flush(yaml_writer_ctx* ctx)
 {
     UINT bytes_written;
+    UINT len = ctx->buffered;
+    if (len == 0) return true;
+
+    ctx->buffered = 0;
+    ctx->result = f_write(ctx->file, yamlBuffer, len, &bytes_written);
+    if (ctx->result == FR_OK && bytes_written != len) {
+        ctx->result = FR_DENIED;  // disk full
+    }
+    return ctx->result == FR_OK;
+}
+
+static bool yaml_writer(void* opaque, const char* str, size_t len)
+{
     yaml_writer_ctx* ctx = (yaml_writer_ctx*)opaque;
 
 #if defined(DEBUG_YAML)
     TRACE_NOCRLF("%.*s",len,str);
 #endif
 
-    ctx->result = f_write(ctx->file, str, len, &bytes_written);
-    return (ctx->result == FR_OK) && (bytes_written == len);
+    while (len > 0) {
+      size_t chunk = min<size_t>(len, YAML_BUFFER_SIZE - ctx->buffered);
+      memcpy(yamlBuffer + ctx->buffered, str, chunk);
+      ctx->buffered += chunk;
+      str += chunk;
+      len -= chunk;
+      if (ctx->buffered == YAML_BUFFER_SIZE && !yaml_writer_flush(ctx))
+        return false;
+    }
+    return true;
 }
 
-const char* writeFileYaml(const char* path, const YamlNode* root_node, uint8_t* data, uint16_t checksum)
+static const char* writeYamlTree(const char* path, const YamlNode* root_node,
+                                 uint8_t* data, uint16_t checksum)
 {
     FIL file;
 
@@ -271,26 +423,61 @@ const char* writeFileYaml(const char* path, const YamlNode* root_node, uint8_t*
     yaml_writer_ctx ctx;
     ctx.file = &file;
     ctx.result = FR_OK;
+    ctx.buffered = 0;
 
     // Try to add CRC
     if (checksum != 0) {
-      if (!yaml_writer(&ctx, YAMLFILE_CHECKSUM_TAG_NAME, strlen(YAMLFILE_CHECKSUM_TAG_NAME))) return NULL;
-      if (!yaml_writer(&ctx, ": ", 2)) return SDCARD_ERROR(FR_INVALID_PARAMETER);
-      const char* p_out = NULL;
-      p_out = yaml_unsigned2str((int)checksum);
-      if (p_out && !yaml_writer(&ctx, p_out, strlen(p_out))) return SDCARD_ERROR(FR_INVALID_PARAMETER);
+      yaml_writer(&ctx, YAMLFILE_CHECKSUM_TAG_NAME, strlen(YAMLFILE_CHECKSUM_TAG_NAME));
+      yaml_writer(&ctx, ": ", 2);
+      const char* p_out = yaml_unsigned2str((int)checksum);
+      if (p_out) yaml_writer(&ctx, p_out, strlen(p_out));
       yaml_writer(&ctx, "\r\n", 2);
     }
 
-
-    if (!tree.generate(yaml_writer, &ctx)) {
-        if (ctx.result != FR_OK) {
-            f_close(&file);
-            return SDCARD_ERROR(ctx.result);
-        }
+    if (ctx.result == FR_OK) {
+      tree.generate(yaml_writer, &ctx);
+    }
+    if (ctx.result == FR_OK) {
+      yaml_writer_flush(&ctx);
     }
 
     f_close(&file);
+    if (ctx.result != FR_OK) {
+        return SDCARD_ERROR(ctx.result);
+    }
+    return NULL;
+}
+
+const char* writeFileYaml(const char* path, const YamlNode* root_node, uint8_t* data, uint16_t checksum)
+{
+    // Generating the file twice costs much less than writing
+    // it again when nothing changed
+    uint16_t yaml_checksum;
+    uint32_t yaml_size;
+    if (yamlGeneratedChecksum(root_node, data, &yaml_checksum, &yaml_size) &&
+        yamlFileUnchanged(path, yaml_checksum, yaml_size)) {
+      TRACE("YAML file unchanged: %s", path);
+      return NULL;
+    }
+
+    // A power loss while writing must not leave a truncated file behind:
+    // the previous version is kept until the new one is complete
+    char tmpPath[LEN_YAML_PATH_MAX];
+    if (!getYamlTmpPath(tmpPath, path)) {
+      return SDCARD_ERROR(FR_INVALID_NAME);
+    }
+
+    const char* error = writeYamlTree(tmpPath, root_node, data, checksum);
+    if (error) {
+      f_unlink(tmpPath);
+      return error;
+    }
+
+    f_unlink(path);
+    FRESULT result = f_rename(tmpPath, path);
+    if (result != FR_OK) {
+      return SDCARD_ERROR(result);
+    }
     return NULL;
 }
 
@@ -298,12 +485,21 @@ const char * writeGeneralSettings()
 {
     TRACE("YAML radio settings writer");
     uint16_t file_checksum = 0;
+    uint32_t file_size = 0;
 
-    YamlFileChecksum(get_radiodata_nodes(), (uint8_t*)&g_eeGeneral, &file_checksum);
+    yamlGeneratedChecksum(get_radiodata_nodes(), (uint8_t*)&g_eeGeneral,
+                          &file_checksum, &file_size);
     g_eeGeneral.manuallyEdited = false;
 
-    const char *p = writeFileYaml(RADIO_SETTINGS_TMPFILE_YAML_PATH, get_radiodata_nodes(),
-                         (uint8_t*)&g_eeGeneral, file_checksum);
+    if (yamlFileUnchanged(RADIO_SETTINGS_YAML_PATH, file_checksum, file_size)) {
+        TRACE("generalSettings unchanged");
+        return nullptr;
+    }
+
+    // radio.yml has its own temporary file, which is also
+    // the fallback when its checksum does not match
+    const char *p = writeYamlTree(RADIO_SETTINGS_TMPFILE_YAML_PATH, get_radiodata_nodes(),
+                                  (uint8_t*)&g_eeGeneral, file_checksum);
     TRACE("generalSettings written with checksum %u", file_checksum);
 
     if (p != NULL) {
@@ -319,6 +515,243 @@ const char * writeGeneralSettings()
 }
 
 
+//
+// Binary model snapshots
+//
+// A copy of ModelData, as loaded from (or saved to) its YAML file, is kept
+// in MODELS_CACHE_PATH. It is keyed by the size and CRC of the YAML file
+// and by the firmware build, so that switching to a model which did not
+// change since costs reading both files, but no parsing. The YAML file
+// contents are checked, rather than its date: it may be rewritten by the
+// file manager, Lua or USB, within the 2s resolution of FAT dates.
+//
+
+PACK(struct ModelCacheHeader {
+  char magic[4];     // "ETMC"
+  uint16_t layout;   // firmware build, see getModelCacheLayout()
+  uint16_t crc;      // model data
+  uint32_t size;     // sizeof(ModelData)
+  uint32_t fsize;    // YAML file size
+  uint16_t fcrc;     // YAML file contents
+});
+
+static const char modelCacheMagic[4] = {'E', 'T', 'M', 'C'};
+
+static uint16_t getModelCacheLayout()
+{
+  // any other firmware build may have a different ModelData layout
+  return crc16(CRC_1021, (const uint8_t*)vers_stamp, strlen(vers_stamp));
+}
+
+// returns false if the file name is too long
+static bool getModelCachePath(char* path, const char* filename)
+{
+  const char* ext = strrchr(filename, '.');
+  unsigned len = ext ? ext - filename : strlen(filename);
+  if (len > LEN_MODEL_FILENAME)
+    return false;
+
+  strcpy(path, MODELS_CACHE_PATH "/");
+  char* tmp = strAppend(path + sizeof(MODELS_CACHE_PATH), filename, len);
+  strcpy(tmp, MODELS_CACHE_EXT);
+  return true;
+}
+
+// one read of the whole file, without parsing it
+static bool getYamlFileSum(const char* path, YamlFileSum* sum)
+{
+  FIL file;
+  if (f_open(&file, path, FA_OPEN_EXISTING | FA_READ) != FR_OK)
+    return false;
+
+  sum->crc = 0;
+  sum->size = 0;
+  UINT read;
+  FRESULT result;
+  while ((result = f_read(&file, yamlBuffer, YAML_BUFFER_SIZE, &read)) == FR_OK &&
+         read > 0) {
+    sum->crc = crc16(CRC_1021, (const uint8_t*)yamlBuffer, read, sum->crc);
+    sum->size += read;
+  }
+  sum->complete = result == FR_OK && sum->size == f_size(&file);
+
+  f_close(&file);
+  return sum->complete;
+}
+
+static void fillModelCacheHeader(ModelCacheHeader* header,
+                                 const YamlFileSum* sum)
+{
+  memcpy(header->magic, modelCacheMagic, sizeof(header->magic));
+  header->layout = getModelCacheLayout();
+  header->size = sizeof(ModelData);
+  header->fsize = sum->size;
+  header->fcrc = sum->crc;
+}
+
+static bool fillModelCacheHeader(ModelCacheHeader* header, const char* path)
+{
+  YamlFileSum sum;
+  if (!getYamlFileSum(path, &sum))
+    return false;
+
+  fillModelCacheHeader(header, &sum);
+  return true;
+}
+
+static bool readModelCache(const char* filename, const char* path,
+                           uint8_t* buffer)
+{
+  char cachePath[sizeof(MODELS_CACHE_PATH) + LEN_MODEL_FILENAME +
+                 sizeof(MODELS_CACHE_EXT)];
+  ModelCacheHeader expected;
+  if (!getModelCachePath(cachePath, filename) ||
+      !fillModelCacheHeader(&expected, path))
+    return false;
+
+  FIL file;
+  if (f_open(&file, cachePath, FA_OPEN_EXISTING | FA_READ) != FR_OK)
+    return false;
+
+  ModelCacheHeader header;
+  UINT read;
+  bool valid =
+      f_read(&file, &header, sizeof(header), &read) == FR_OK &&
+      read == sizeof(header) &&
+      memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0 &&
+      header.layout == expected.layout && header.size == expected.size &&
+      header.fsize == expected.fsize && header.fcrc == expected.fcrc &&
+      f_read(&file, buffer, sizeof(ModelData), &read) == FR_OK &&
+      read == sizeof(ModelData) &&
+      header.crc == crc16(CRC_1021, buffer, sizeof(ModelData));
+
+  f_close(&file);
+  return valid;
+}
+
+// the header is filled from the YAML file the data was read from or saved to
+static void writeModelCache(const char* filename, ModelCacheHeader header,
+                            const uint8_t* data)
+{
+  char cachePath[sizeof(MODELS_CACHE_PATH) + LEN_MODEL_FILENAME +
+                 sizeof(MODELS_CACHE_EXT)];
+  if (!getModelCachePath(cachePath, filename))
+    return;
+
+  header.crc = crc16(CRC_1021, data, sizeof(ModelData));
+
+  // unchanged models are not written again (see writeFileYaml())
+  FIL file;
+  if (f_open(&file, cachePath, FA_OPEN_EXISTING | FA_READ) == FR_OK) {
+    ModelCacheHeader current;
+    UINT read;
+    bool unchanged = f_read(&file, &current, sizeof(current), &read) == FR_OK &&
+                     read == sizeof(current) &&
+                     memcmp(&current, &header, sizeof(header)) == 0;
+    f_close(&file);
+    if (unchanged)
+      return;
+  }
+
+  FRESULT result = f_open(&file, cachePath, FA_CREATE_ALWAYS | FA_WRITE);
+  if (result == FR_NO_PATH) {
+    if (sdCheckAndCreateDirectory(MODELS_CACHE_PATH) != nullptr)
+      return;
+    result = f_open(&file, cachePath, FA_CREATE_ALWAYS | FA_WRITE);
+  }
+  if (result != FR_OK)
+    return;
+
+  UINT written;
+  if (f_write(&file, &header, sizeof(header), &written) != FR_OK ||
+      written != sizeof(header) ||
+      f_write(&file, data, sizeof(ModelData), &written) != FR_OK ||
+      written != sizeof(ModelData)) {
+    f_close(&file);
+    f_unlink(cachePath);
+    return;
+  }
+
+  f_close(&file);
+}
+
+//
+// Prefetched model
+//
+// The model focused in the model select screen is read ahead into a spare
+// buffer, so that selecting it costs a copy. It is keyed like snapshots,
+// and used once.
+//
+
+static ModelData* prefetchedModel = nullptr;
+static ModelCacheHeader prefetchedHeader;
+static char prefetchedFilename[LEN_MODEL_FILENAME + 1];
+
+ModelPrefetchStats modelPrefetchStats;
+
+const char* prefetchModelYaml(const char* filename)
+{
+  if (!prefetchedModel) {
+    prefetchedModel = (ModelData*)malloc(sizeof(ModelData));
+    if (!prefetchedModel) return "out of memory";
+  }
+
+  prefetchedFilename[0] = '\0';
+
+  const char* error =
+      readModelYaml(filename, (uint8_t*)prefetchedModel, sizeof(ModelData));
+  if (error) return error;
+
+  char path[256];
+  getModelPath(path, filename);
+  if (!fillModelCacheHeader(&prefetchedHeader, path))
+    return SDCARD_ERROR(FR_NO_FILE);
+
+  strAppend(prefetchedFilename, filename, LEN_MODEL_FILENAME);
+  modelPrefetchStats.prefetches++;
+  return nullptr;
+}
+
+void releasePrefetchedModel()
+{
+  free(prefetchedModel);
+  prefetchedModel = nullptr;
+  prefetchedFilename[0] = '\0';
+}
+
+static bool readPrefetchedModel(const char* filename, const char* path,
+                                uint8_t* buffer)
+{
+  if (!prefetchedFilename[0] ||
+      strncmp(prefetchedFilename, filename, LEN_MODEL_FILENAME))
+    return false;
+
+  prefetchedFilename[0] = '\0';
+
+  ModelCacheHeader current;
+  if (!fillModelCacheHeader(&current, path) ||
+      current.fsize != prefetchedHeader.fsize ||
+      current.fcrc != prefetchedHeader.fcrc) {
+    modelPrefetchStats.stale++;
+    return false;
+  }
+
+  memcpy(buffer, prefetchedModel, sizeof(ModelData));
+  modelPrefetchStats.hits++;
+  return true;
+}
+
+void removeModelCache(const char* filename)
+{
+  char cachePath[sizeof(MODELS_CACHE_PATH) + LEN_MODEL_FILENAME +
+                 sizeof(MODELS_CACHE_EXT)];
+  if (getModelCachePath(cachePath, filename))
+    f_unlink(cachePath);
+
+  if (!strncmp(prefetchedFilename, filename, LEN_MODEL_FILENAME))
+    prefetchedFilename[0] = '\0';
+}
+
 const char * readModelYaml(const char * filename, uint8_t * buffer, uint32_t size, const char* pathName)
 {
     // YAML reader
@@ -341,6 +774,17 @@ const char * readModelYaml(const char * filename, uint8_t * buffer, uint32_t siz
     char path[256];
     getModelPath(path, filename, pathName);
 
+    // templates are not cached
+    bool use_cache = init_model && !strcmp(pathName, STR_MODELS_PATH);
+    if (use_cache && readPrefetchedModel(filename, path, buffer)) {
+      TRACE("YAML model prefetched");
+      return nullptr;
+    }
+    if (use_cache && readModelCache(filename, path, buffer)) {
+      TRACE("YAML model cache hit");
+      return nullptr;
+    }
+
     YamlTreeWalker tree;
     tree.reset(data_nodes, buffer);
 
@@ -368,7 +812,17 @@ const char * readModelYaml(const char * filename, uint8_t * buffer, uint32_t siz
       md->rfAlarms.critical = 42;
     }
 
-    return readYamlFile(path, YamlTreeWalker::get_parser_calls(), &tree, NULL);
+    // the cache key comes from this read, rather than from reading again
+    YamlFileSum sum;
+    const char* error = parseYamlFile(path, YamlTreeWalker::get_parser_calls(), &tree, NULL,
+                                      use_cache ? &sum : NULL);
+    if (!error && use_cache && sum.complete) {
+      ModelCacheHeader header;
+      fillModelCacheHeader(&header, &sum);
+      writeModelCache(filename, header, buffer);
+    }
+
+    return error;
 }
 
 static const char _wrongExtentionError[] = "wrong file extension";
@@ -388,7 +842,13 @@ const char * writeModelYaml(const char* filename)
     TRACE("YAML model writer");
     char path[256];
     getModelPath(path, filename);
-    return writeFileYaml(path, get_modeldata_nodes(), (uint8_t*)&g_model,0 );
+    const char* error = writeFileYaml(path, get_modeldata_nodes(), (uint8_t*)&g_model,0 );
+    ModelCacheHeader header;
+    if (!error && fillModelCacheHeader(&header, path)) {
+      writeModelCache(filename, header, (uint8_t*)&g_model);
+    }
+
+    return error;
 }
 
 #if !defined(STORAGE_MODELSLIST)
@@ -491,14 +951,17 @@ void swapModels(uint8_t id1, uint8_t id2)
   FILINFO fno;
   if (f_stat(fname2,&fno) != FR_OK) {
     if (f_stat(fname1,&fno) == FR_OK) {
-      if (f_rename(fname1, fname2) == FR_OK)
+      if (f_rename(fname1, fname2) == FR_OK) {
+        removeModelCache(fname2 + sizeof(MODELS_PATH));
         swapModelHeaders(id1,id2);
+      }
     }
     return;
   }
 
   if (f_stat(fname1,&fno) != FR_OK) {
-    f_rename(fname2, fname1);
+    if (f_rename(fname2, fname1) == FR_OK)
+      removeModelCache(fname1 + sizeof(MODELS_PATH));
     return;
   }
 
@@ -520,6 +983,10 @@ void swapModels(uint8_t id1, uint8_t id2)
     return;
   }
 
+  // renamed files keep their date: the snapshots would still match
+  removeModelCache(fname1 + sizeof(MODELS_PATH));
+  removeModelCache(fname2 + sizeof(MODELS_PATH));
+
   swapModelHeaders(id1,id2);
 }
 
@@ -532,6 +999,7 @@ int8_t deleteModel(uint8_t idx)
   if (f_unlink(fname) != FR_OK) {
     return -1;
   }
+  removeModelCache(fname + sizeof(MODELS_PATH));
 
   modelHeaders[idx].name[0] = '\0';
   return 0;
@@ -26,9 +26,32 @@ enum class ChecksumResult {Success, Failed, None};
 
 constexpr uint8_t MODELIDX_STRLEN = sizeof(MODEL_FILENAME_PREFIX "00");
 
+struct YamlParserCalls;
+
+// parses a YAML file, 'checksum_result' is optional
+const char * readYamlFile(const char* fullpath, const YamlParserCalls* calls, void* parser_ctx, ChecksumResult* checksum_result);
+
 const char * loadRadioSettingsYaml(bool checks);
 const char * writeModelYaml(const char* filename);
 const char * readModelYaml(const char * filename, uint8_t * buffer, uint32_t size, const char* pathName = STR_MODELS_PATH);
+// to be called when a model file is renamed or deleted
+void removeModelCache(const char* filename);
+
+// reads a model ahead, so that the next readModelYaml() of that
+// model is a copy, unless its file changed since
+const char* prefetchModelYaml(const char* filename);
+void releasePrefetchedModel();
+
+struct ModelPrefetchStats {
+  uint32_t prefetches;
+  uint32_t hits;
+  uint32_t stale;        // prefetched model changed before being selected
+  uint32_t lastSelectMs; // model selection until the model is ready
+  uint32_t maxSelectMs;
+};
+
+extern ModelPrefetchStats modelPrefetchStats;
+
 bool YamlFileChecksum(const YamlNode* root_node, uint8_t* data, uint16_t* checksum);
 
 void getModelNumberStr(uint8_t idx, char* model_idx);
@@ -32,9 +32,31 @@
   #define WRITE_DELAY_10MS 200
 #endif
 
+// consecutive writes are at least that far apart, so that changes
+// made in a row (trims, GVARs...) are coalesced into fewer writes
+#define WRITE_INTERVAL_10MS  (4 * WRITE_DELAY_10MS)
+
+// while logs are written or the mixer is busy, writes are held back
+// for at most that long
+#if defined(RTC_BACKUP_RAM)
+  #define WRITE_MAX_DEFER_10MS 30000 /* 5min */
+#else
+  #define WRITE_MAX_DEFER_10MS 6000 /* 1min */
+#endif
+
 extern uint8_t   storageDirtyMsk;
 extern tmr10ms_t storageDirtyTime10ms;
-#define TIME_TO_WRITE()                (storageDirtyMsk && (tmr10ms_t)(get_tmr10ms() - storageDirtyTime10ms) >= (tmr10ms_t)WRITE_DELAY_10MS)
+#define TIME_TO_WRITE()                storageWriteDue()
+
+struct StorageWriteStats {
+  uint32_t requests;    // storageDirty() calls
+  uint32_t writes;      // storageCheck() passes which wrote something
+  uint16_t forced;      // of which immediate ones (model change, shutdown...)
+  uint16_t deferred;    // writes held back while busy
+  tmr10ms_t maxPending; // longest time changes stayed unsaved
+};
+
+extern StorageWriteStats storageWriteStats;
 
 #if defined(RTC_BACKUP_RAM)
 #include "storage/rtc_backup.h"
@@ -55,6 +77,8 @@ void storageCheck(bool immediately);
 // Generic storage functions (implemented in storage_common.cpp)
 //
 void storageDirty(uint8_t msk);
+bool storageWriteDue();
+void storageWritten(uint8_t msk, bool immediately);
 void storageFlushCurrentModel();
 void postRadioSettingsLoad();
 void preModelLoad();
@@ -22,6 +22,7 @@
 #include "opentx.h"
 #include "timers_driver.h"
 #include "tasks/mixer_task.h"
+#include "mixer_scheduler.h"
 #include "mixes.h"
 
 #if defined(USBJ_EX)
@@ -37,6 +38,11 @@
 
 uint8_t   storageDirtyMsk;
 tmr10ms_t storageDirtyTime10ms;
+static tmr10ms_t storagePendingTime10ms;  // oldest unsaved change
+// as if written long enough ago: the first change after boot is not held
+static tmr10ms_t storageWriteTime10ms = -(tmr10ms_t)WRITE_INTERVAL_10MS;
+static bool storageDeferred;
+StorageWriteStats storageWriteStats;
 
 #if defined(RTC_BACKUP_RAM)
 uint8_t   rambackupDirtyMsk = EE_GENERAL | EE_MODEL;
@@ -45,8 +51,13 @@ tmr10ms_t rambackupDirtyTime10ms;
 
 void storageDirty(uint8_t msk)
 {
+  tmr10ms_t now = get_tmr10ms();
+  if (!storageDirtyMsk)
+    storagePendingTime10ms = now;
+
   storageDirtyMsk |= msk;
-  storageDirtyTime10ms = get_tmr10ms();
+  storageDirtyTime10ms = now;
+  storageWriteStats.requests++;
 
 #if defined(RTC_BACKUP_RAM)
   rambackupDirtyMsk = storageDirtyMsk;
@@ -54,6 +65,59 @@ void storageDirty(uint8_t msk)
 #endif
 }
 
+static bool storageBusy()
+{
+#if defined(SDCARD)
+  if (g_oLogFile.obj.fs)
+    return true;
+#endif
+
+  // the last mixer run took more than half of its period
+  return mixerTaskRunning() &&
+         lastMixerDuration * 2 > getMixerSchedulerPeriod();
+}
+
+bool storageWriteDue()
+{
+  if (!storageDirtyMsk)
+    return false;
+
+  tmr10ms_t now = get_tmr10ms();
+  if ((tmr10ms_t)(now - storageDirtyTime10ms) < (tmr10ms_t)WRITE_DELAY_10MS ||
+      (tmr10ms_t)(now - storageWriteTime10ms) < (tmr10ms_t)WRITE_INTERVAL_10MS)
+    return false;
+
+  if (storageBusy() &&
+      (tmr10ms_t)(now - storagePendingTime10ms) < (tmr10ms_t)WRITE_MAX_DEFER_10MS) {
+    if (!storageDeferred) {
+      storageDeferred = true;
+      storageWriteStats.deferred++;
+    }
+    return false;
+  }
+
+  return true;
+}
+
+void storageWritten(uint8_t msk, bool immediately)
+{
+  if (!msk)
+    return;
+
+  tmr10ms_t now = get_tmr10ms();
+  tmr10ms_t pending = now - storagePendingTime10ms;
+  if (pending > storageWriteStats.maxPending)
+    storageWriteStats.maxPending = pending;
+
+  storageWriteStats.writes++;
+  if (immediately)
+    storageWriteStats.forced++;
+
+  storageWriteTime10ms = now;
+  storagePendingTime10ms = now;
+  storageDeferred = false;
+}
+
 void preModelLoad()
 {
   watchdogSuspend(500/*5s*/);
@@ -1641,6 +1641,10 @@ static void r_customFn(void* user, uint8_t* data, uint32_t bitoffs,
       // repeat time in seconds
       CFN_PLAY_REPEAT(cfn) = yaml_str2uint(val,val_len) / CFN_PLAY_REPEAT_MUL;
     }
+  } else if (func == FUNC_LOGS && val_len > 0) {
+    // sticks and channels sampling rate (Hz)
+    CFN_LOGS_FAST_RATE(cfn) =
+        min<uint32_t>(yaml_str2uint(val, val_len), SD_LOGS_FAST_RATE_MAX);
   }
 }
 
@@ -1794,6 +1798,11 @@ static bool w_customFn(void* user, uint8_t* data, uint32_t bitoffs,
       str = yaml_unsigned2str(CFN_PLAY_REPEAT(cfn) * CFN_PLAY_REPEAT_MUL);
       if (!wf(opaque, str, strlen(str))) return false;
     }
+  } else if (func == FUNC_LOGS && CFN_LOGS_FAST_RATE(cfn)) {
+    // ",Hz" (omitted when sticks and channels are logged with sensors)
+    if (!wf(opaque,",",1)) return false;
+    str = yaml_unsigned2str(CFN_LOGS_FAST_RATE(cfn));
+    if (!wf(opaque, str, strlen(str))) return false;
   }
   if (!wf(opaque, "\"", 1)) return false;
   return true;
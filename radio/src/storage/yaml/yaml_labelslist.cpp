@@ -127,30 +127,25 @@ static bool find_node(void* ctx, char* buf, uint8_t len)
 
     // Model List
     if(mi->level == 1 && mi->section == labelslist_iter::SEC_Models)  {
-      bool found=false;
-      for(auto &filehash : modelslist.fileHashInfo) {
-        if(filehash.name == mi->current_attr) {
-          TRACE_LABELS_YAML("  Model %s has a real file, creating a modelcell", mi->current_attr);
-          if(filehash.celladded) {
-            TRACE_LABELS_YAML("    Duplicate found labels.yml model cell %s already added", mi->current_attr);
-            break;
-          }
-          ModelCell *model = new ModelCell(mi->current_attr);
-          strcpy(model->modelFinfoHash, filehash.hash);
-          modelslist.push_back(model);
-          filehash.celladded = true;
-          if(filehash.curmodel == true)
-            modelslist.setCurrentModel(model);
-          mi->curmodel = model;
-          mi->modeldatavalid = false;
-          mi->curmodel->_isDirty = true;
-          found = true;
-          break;
-        }
-      }
-      if(!found) {
+      auto it = modelslist.fileHashInfo.find(mi->current_attr);
+      if (it == modelslist.fileHashInfo.end()) {
         mi->curmodel = NULL;
         TRACE_LABELS_YAML("File does not exist in /MODELS");
+      } else if (it->second.celladded) {
+        mi->curmodel = NULL;
+        TRACE_LABELS_YAML("    Duplicate found labels.yml model cell %s already added", mi->current_attr);
+      } else {
+        auto &filehash = it->second;
+        TRACE_LABELS_YAML("  Model %s has a real file, creating a modelcell", mi->current_attr);
+        ModelCell *model = new ModelCell(mi->current_attr);
+        strcpy(model->modelFinfoHash, filehash.hash);
+        modelslist.push_back(model);
+        filehash.celladded = true;
+        if(filehash.curmodel == true)
+          modelslist.setCurrentModel(model);
+        mi->curmodel = model;
+        mi->modeldatavalid = false;
+        mi->curmodel->_isDirty = true;
       }
     }
 
@@ -195,8 +190,7 @@ static void set_attr(void* ctx, char* buf, uint16_t len)
     }
 
     // Last Opened
-    // Hack: Always load this as the hash value is (currently) not in synch with the saved model file
-    // TODO: Ensure stored hash is up to date.
+    // Not stored in the model file: always load it
     if (!strcasecmp(mi->current_attr, "lastopen")) {
         mi->curmodel->lastOpened = (gtime_t)strtol(value, NULL, 0);
         TRACE_LABELS_YAML(" Last Opened %lu", value);
@@ -249,27 +249,68 @@ void YamlTreeWalker::rewind()
     }
 }
 
+static bool yaml_tag_match(const YamlNode* attr, const char* tag,
+                           uint8_t tag_len)
+{
+    // most attributes differ by their first char: avoid strlen()
+    if (tag_len && (!attr->tag || attr->tag[0] != tag[0]))
+        return false;
+
+    return (tag_len == attr->tag_len())
+        && !strncmp(tag, attr->tag, tag_len);
+}
+
 // Increment the cursor until a match is found or the end of
 // the current collection (node of type YDT_NONE) is reached.
 //
+// As keys are mostly written in the order of the node table, the
+// search starts at the current attribute and wraps around to the
+// first one only if needed: loading a file written by the radio
+// only costs one or two compares per key instead of a full scan.
+//
 // return true if a match has been found.
 bool YamlTreeWalker::findNode(const char* tag, uint8_t tag_len)
 {
     if (virt_level)
         return false;
 
-    rewind();
-
-    const struct YamlNode* attr = getAttr();
-    if (isArrayElmt() && attr && attr->type == YDT_IDX) {
+    const YamlNode* node = getNode();
+    if (isArrayElmt() && node->u._array.child[0].type == YDT_IDX) {
+        rewind();
         setAttrValue((char*)tag, tag_len);
         return true;
     }
 
+    // union members share the same offset: always start from the first one
+    if (node->type != YDT_ARRAY)
+        rewind();
+
+    uint8_t level = stack_level;
+    int8_t start_idx = stack[level].attr_idx;
+
+    const struct YamlNode* attr = getAttr();
     while(attr && attr->type != YDT_NONE) {
 
-        if ((tag_len == attr->tag_len())
-            && !strncmp(tag, attr->tag, tag_len)) {
+        if (yaml_tag_match(attr, tag, tag_len)) {
+            return true; // attribute found!
+        }
+
+        toNextAttr();
+        attr = getAttr();
+    }
+
+    if (start_idx <= 0 || stack_level != level)
+        return false;
+
+    // not found after the start attribute: look at the ones before it
+    int8_t end_idx = stack[level].attr_idx;
+    uint32_t end_ofs = getAttrOfs();
+
+    rewind();
+    attr = getAttr();
+    while (stack_level != level || stack[level].attr_idx < start_idx) {
+
+        if (yaml_tag_match(attr, tag, tag_len)) {
             return true; // attribute found!
         }
 
@@ -277,6 +318,10 @@ bool YamlTreeWalker::findNode(const char* tag, uint8_t tag_len)
         attr = getAttr();
     }
 
+    // leave the cursor at the end of the table, as a full scan would
+    setAttrIdx(end_idx);
+    setAttrOfs(end_ofs);
+
     return false;
 }
 
@@ -21,6 +21,7 @@
 
 #include "diskio_spi_flash.h"
 #include "spi_flash.h"
+#include "timers_driver.h"
 
 #if !defined(DISABLE_FLASH_FTL)
 #define USE_FLASH_FTL
@@ -74,6 +75,16 @@ static const FrFTLOps _frftl_cb = {
   .flashErase = flashErase,
   .isFlashErased = isFlashErased,
 };
+
+bool spiFlashGetFTLStats(FrFTLStats* stats, uint16_t* erasedPages)
+{
+  if (!_frftl.callbacks) {
+    return false;
+  }
+  *stats = _frftl.stats;
+  *erasedPages = ftlGetErasedPageCount(&_frftl);
+  return true;
+}
 #endif
 
 static DSTATUS spi_flash_initialize(BYTE lun)
@@ -174,6 +185,18 @@ static DRESULT spi_flash_ioctl(BYTE lun, BYTE ctrl, void *buff)
 #endif
     break;
 
+  case CTRL_IDLE:
+#if defined(USE_FLASH_FTL)
+    {
+      // pages are erased ahead here rather than while writing
+      uint32_t start = timersGetMsTick();
+      while (ftlGarbageCollect(&_frftl) &&
+             timersGetMsTick() - start < *(uint32_t*)buff) {
+      }
+    }
+#endif
+    break;
+
   case CTRL_TRIM:
 #if defined(USE_FLASH_FTL)
     if (!ftlTrim(&_frftl, *(DWORD*)buff, 1 + *((DWORD*)buff + 1) - *(DWORD*)buff)) {
@@ -24,3 +24,10 @@
 #include "hal/fatfs_diskio.h"
 
 extern const diskio_driver_t spi_flash_diskio_driver;
+
+#if !defined(DISABLE_FLASH_FTL)
+#include "drivers/frftl.h"
+
+// returns false if the FTL is not initialized
+bool spiFlashGetFTLStats(FrFTLStats* stats, uint16_t* erasedPages);
+#endif
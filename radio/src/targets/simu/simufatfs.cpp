@@ -398,6 +398,14 @@ UINT f_size(FIL* fil)
   return 0;
 }
 
+FRESULT f_sync (FIL * fil)
+{
+  if (fil && fil->obj.fs) {
+    fflush((FILE*)fil->obj.fs);
+  }
+  return FR_OK;
+}
+
 FRESULT f_close (FIL * fil)
 {
   TRACE_SIMPGMSPACE("f_close(%p) (FIL:%p)", fil->obj.fs, fil);
@@ -617,6 +625,9 @@ FRESULT f_getfree (const TCHAR* path, DWORD* nclst, FATFS** fatfs)
 
 void storageInit() {}
 void storagePreMountHook() {}
+void storagePreUnmountHook() {}
+void storagePeriodicHook() {}
+void storageIdleHook() {}
 bool storageIsPresent() { return true; }
 
 #endif  // #if defined(SIMU_USE_SDCARD)
@@ -27,6 +27,10 @@
 
 #include "watchdog_driver.h"
 
+#if defined(LOGS_BINARY)
+  #include "logs_binary.h"
+#endif
+
 RTOS_TASK_HANDLE menusTaskId;
 RTOS_DEFINE_STACK(menusTaskId, menusStack, MENUS_STACK_SIZE);
 
@@ -104,6 +108,10 @@ void tasksStart()
   cliStart();
 #endif
 
+#if defined(LOGS_BINARY)
+  logsBinaryStart();
+#endif
+
   RTOS_CREATE_TASK(menusTaskId, menusTask, "menus", menusStack,
                    MENUS_STACK_SIZE, MENUS_TASK_PRIO);
 
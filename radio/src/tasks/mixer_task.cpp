@@ -28,6 +28,10 @@
 
 #include "watchdog_driver.h"
 
+#if defined(LOGS_BINARY)
+  #include "logs_binary.h"
+#endif
+
 RTOS_TASK_HANDLE mixerTaskId;
 RTOS_DEFINE_STACK(mixerTaskId, mixerStack, MIXER_STACK_SIZE);
 
@@ -196,6 +200,10 @@ TASK_FUNCTION(mixerTask)
       pulsesSendChannels();
       doMixerPeriodicUpdates();
 
+#if defined(LOGS_BINARY)
+      logsSample();
+#endif
+
       // TODO: what are these for???
       DEBUG_TIMER_START(debugTimerMixerCalcToUsage);
       DEBUG_TIMER_SAMPLE(debugTimerMixerIterval);
@@ -214,6 +222,7 @@ TASK_FUNCTION(mixerTask)
       WDG_RESET();
 
       t0 = timersGetUsTick() - t0;
+      lastMixerDuration = t0;
       if (t0 > maxMixerDuration)
         maxMixerDuration = t0;
     }
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) EdgeTX
+ *
+ * Based on code named
+ *   opentx - https://github.com/opentx/opentx
+ *   th9x - http://code.google.com/p/th9x
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "gtests.h"
+#include "audio_kernels.h"
+
+// odd count, to go through the tail of the block kernels too
+#define KERNEL_SAMPLES  (AUDIO_BUFFER_SIZE - 3)
+
+static void randomSamples(int16_t * samples, uint32_t count)
+{
+  for (uint32_t i = 0; i < count; i++) {
+    samples[i] = (int16_t)rand();
+  }
+}
+
+TEST(AudioKernels, Fill)
+{
+  audio_data_t data[KERNEL_SAMPLES + 1];
+  data[KERNEL_SAMPLES] = 0x1234;
+  audioFill(data, KERNEL_SAMPLES, AUDIO_DATA_SILENCE);
+  for (uint32_t i = 0; i < KERNEL_SAMPLES; i++) {
+    ASSERT_EQ(AUDIO_DATA_SILENCE, data[i]);
+  }
+  EXPECT_EQ(0x1234, data[KERNEL_SAMPLES]);
+}
+
+TEST(AudioKernels, MixSaturates)
+{
+  srand(42);
+  for (unsigned shift = 0; shift <= 6; shift++) {
+    audio_data_t data[KERNEL_SAMPLES], expected[KERNEL_SAMPLES];
+    int16_t samples[KERNEL_SAMPLES];
+    randomSamples(samples, KERNEL_SAMPLES);
+    for (uint32_t i = 0; i < KERNEL_SAMPLES; i++) {
+      data[i] = limit<int32_t>(AUDIO_DATA_MIN, AUDIO_DATA_SILENCE + (int16_t)rand(), AUDIO_DATA_MAX);
+      expected[i] = limit<int32_t>(AUDIO_DATA_MIN, data[i] + (samples[i] >> shift), AUDIO_DATA_MAX);
+    }
+    audioMix(data, samples, KERNEL_SAMPLES, shift);
+    for (uint32_t i = 0; i < KERNEL_SAMPLES; i++) {
+      ASSERT_EQ(expected[i], data[i]) << "shift " << shift << " sample " << i;
+    }
+  }
+}
+
+TEST(AudioKernels, Scale)
+{
+  srand(7);
+  for (int32_t gain : {0, 1, 0x4000, 0x7fff, 0x8000, 0xb21d, 0xffff, 0x10000}) {
+    audio_data_t data[KERNEL_SAMPLES], expected[KERNEL_SAMPLES];
+    int16_t samples[KERNEL_SAMPLES];
+    randomSamples(samples, KERNEL_SAMPLES);
+    for (uint32_t i = 0; i < KERNEL_SAMPLES; i++) {
+      data[i] = AUDIO_DATA_SILENCE + samples[i];
+      expected[i] = gain == 0x10000 ? data[i] : (samples[i] * gain >> 16) + AUDIO_DATA_SILENCE;
+    }
+    audioScale(data, KERNEL_SAMPLES, gain);
+    for (uint32_t i = 0; i < KERNEL_SAMPLES; i++) {
+      ASSERT_EQ(expected[i], data[i]) << "gain " << gain << " sample " << i;
+    }
+  }
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) EdgeTX
+ *
+ * Based on code named
+ *   opentx - https://github.com/opentx/opentx
+ *   th9x - http://code.google.com/p/th9x
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#include "gtests.h"
+#include "audio_kernels.h"
+
+#define TONE_SECONDS  1
+
+// What ToneContext::mixBuffer() did before its phase accumulator and its
+// gain were fixed point
+static std::vector<int16_t> floatTone(int freq, int volume)
+{
+  static const uint8_t toneVolumes[] = { 10, 8, 6, 4, 2 };
+  float ratio = toneVolumes[2+volume];
+  if (freq < 330) {
+    ratio = (ratio * freq * freq) / (330 * 330);
+  }
+  // the louder low tones overflowed the samples
+  float gain = min(1.0f, 1.0f / ratio);
+  float step = limit<float>(1, float(freq) * (float(DIM(sineValues))/float(AUDIO_SAMPLE_RATE)), 512);
+  float idx = 0;
+
+  std::vector<int16_t> result;
+  AudioBuffer buffer;
+  int16_t samples[AUDIO_BUFFER_SIZE];
+  for (int n = 0; n < TONE_SECONDS * 1000 / AUDIO_BUFFER_DURATION; n++) {
+    audioFill(buffer.data, AUDIO_BUFFER_SIZE, AUDIO_DATA_SILENCE);
+    for (int i = 0; i < AUDIO_BUFFER_SIZE; i++) {
+      samples[i] = sineValues[int(idx)] * gain;
+      idx += step;
+      if ((unsigned int)idx >= DIM(sineValues))
+        idx -= DIM(sineValues);
+    }
+    audioMix(buffer.data, samples, AUDIO_BUFFER_SIZE, 16-AUDIO_BITS_PER_SAMPLE);
+    for (int i = 0; i < AUDIO_BUFFER_SIZE; i++) {
+      result.push_back(buffer.data[i] - AUDIO_DATA_SILENCE);
+    }
+  }
+  return result;
+}
+
+static std::vector<int16_t> contextTone(int freq, int volume)
+{
+  ToneContext context;
+  context.clear();
+  // longer, so that all the buffers are full
+  context.setFragment(freq, TONE_SECONDS * 1000 + AUDIO_BUFFER_DURATION, 0, 0, 0, false, USE_SETTINGS_VOLUME);
+
+  std::vector<int16_t> result;
+  AudioBuffer buffer;
+  for (int n = 0; n < TONE_SECONDS * 1000 / AUDIO_BUFFER_DURATION; n++) {
+    audioFill(buffer.data, AUDIO_BUFFER_SIZE, AUDIO_DATA_SILENCE);
+    int count = context.mixBuffer(&buffer, volume, 0);
+    for (int i = 0; i < count; i++) {
+      result.push_back(buffer.data[i] - AUDIO_DATA_SILENCE);
+    }
+  }
+  return result;
+}
+
+// Goertzel magnitude of the frequency, relative to a full scale sine
+static double toneLevel(const std::vector<int16_t>& samples, double freq)
+{
+  double coeff = 2 * cos(2 * M_PI * freq / AUDIO_SAMPLE_RATE);
+  double s1 = 0, s2 = 0;
+  for (int16_t sample : samples) {
+    double s = sample + coeff * s1 - s2;
+    s2 = s1;
+    s1 = s;
+  }
+  double power = s1 * s1 + s2 * s2 - coeff * s1 * s2;
+  return 2 * sqrt(power) / samples.size() / 32768;
+}
+
+TEST(AudioTones, Spectrum)
+{
+  for (int freq : {150, 330, 700, 1500, 3000}) {
+    for (int volume : {-2, 0, 2}) {
+      auto reference = floatTone(freq, volume);
+      auto tone = contextTone(freq, volume);
+      ASSERT_EQ(reference.size(), tone.size());
+
+      // the fundamental and the harmonics of the waveform table
+      for (int harmonic = 1; harmonic <= 3; harmonic++) {
+        double expected = toneLevel(reference, freq * harmonic);
+        double level = toneLevel(tone, freq * harmonic);
+        EXPECT_NEAR(expected, level, 0.002 + expected * 0.01)
+            << freq << "Hz harmonic " << harmonic << " volume " << volume;
+      }
+    }
+  }
+}
+
+TEST(AudioTones, EndsOnPeriod)
+{
+  ToneContext context;
+  context.clear();
+  context.setFragment(1000, 25, 0, 0, 0, false, USE_SETTINGS_VOLUME);
+
+  // the last buffer of the tone is mixed, but not counted
+  std::vector<audio_data_t> tone;
+  AudioBuffer buffer;
+  int count;
+  do {
+    audioFill(buffer.data, AUDIO_BUFFER_SIZE, AUDIO_DATA_SILENCE);
+    count = context.mixBuffer(&buffer, 2, 0);
+    tone.insert(tone.end(), buffer.data, buffer.data + AUDIO_BUFFER_SIZE);
+  } while (count > 0);
+
+  int end = tone.size();
+  while (end > 0 && tone[end - 1] == AUDIO_DATA_SILENCE) {
+    end--;
+  }
+
+  // 25ms of 1kHz are 800 samples, a period is 32 samples
+  EXPECT_EQ(0, end % 32);
+  EXPECT_NEAR(800, end, 32);
+}
+
+TEST(AudioTones, Benchmark)
+{
+  const int rounds = 20;
+  using clock = std::chrono::steady_clock;
+
+  auto start = clock::now();
+  for (int i = 0; i < rounds; i++) floatTone(440 + i, 0);
+  auto floatTime = clock::now() - start;
+
+  start = clock::now();
+  for (int i = 0; i < rounds; i++) contextTone(440 + i, 0);
+  auto fixedTime = clock::now() - start;
+
+  double samples = (double)rounds * TONE_SECONDS * AUDIO_SAMPLE_RATE;
+  printf("float tones: %.1f ns/sample, fixed point tones: %.1f ns/sample\n",
+         std::chrono::duration<double, std::nano>(floatTime).count() / samples,
+         std::chrono::duration<double, std::nano>(fixedTime).count() / samples);
+}
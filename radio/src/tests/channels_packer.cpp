@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) EdgeTX
+ *
+ * Based on code named
+ *   opentx - https://github.com/opentx/opentx
+ *   th9x - http://code.google.com/p/th9x
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "gtests.h"
+#include "pulses/channels_packer.h"
+
+// What the CRSF, SBUS and Multi encoders did before using ChannelsPacker
+static void legacyPack(uint8_t * buf, const uint16_t * values, int count, int chanBits)
+{
+  uint32_t bits = 0;
+  uint8_t bitsavailable = 0;
+  for (int i = 0; i < count; i++) {
+    bits |= (uint32_t)values[i] << bitsavailable;
+    bitsavailable += chanBits;
+    while (bitsavailable >= 8) {
+      *buf++ = bits;
+      bits >>= 8;
+      bitsavailable -= 8;
+    }
+  }
+}
+
+// One bit after the other
+static void referencePack(uint8_t * buf, const uint16_t * values, unsigned count,
+                          unsigned chanBits, ChannelsBitOrder order)
+{
+  memset(buf, 0, (count * chanBits + 7) / 8);
+  for (unsigned i = 0; i < count; i++) {
+    for (unsigned b = 0; b < chanBits; b++) {
+      unsigned pos = i * chanBits + b;
+      if (order == CHANNELS_LSB_FIRST) {
+        if (values[i] & (1 << b))
+          buf[pos / 8] |= 1 << (pos % 8);
+      }
+      else {
+        if (values[i] & (1 << (chanBits - 1 - b)))
+          buf[pos / 8] |= 0x80 >> (pos % 8);
+      }
+    }
+  }
+}
+
+template <unsigned BITS, unsigned COUNT, ChannelsBitOrder ORDER>
+static void checkRoundTrip()
+{
+  typedef ChannelsPacker<BITS, COUNT, ORDER> Packer;
+  const unsigned size = Packer::FRAME_SIZE;
+  const uint16_t max = Packer::MAX_VALUE;
+
+  srand(BITS * 100 + COUNT);
+  for (int round = 0; round < 200; round++) {
+    uint16_t values[COUNT], result[COUNT];
+    for (unsigned i = 0; i < COUNT; i++) {
+      values[i] = round == 0 ? max : round == 1 ? 0 : rand() & max;
+    }
+
+    // the byte after the frame is not written
+    uint8_t frame[size + 1], expected[size];
+    frame[size] = 0x5A;
+    Packer::pack(frame, values);
+    referencePack(expected, values, COUNT, BITS, ORDER);
+    ASSERT_EQ(0, memcmp(expected, frame, size))
+        << BITS << " bits, " << COUNT << " channels, round " << round;
+    ASSERT_EQ(0x5A, frame[size]);
+
+    Packer::unpack(frame, result);
+    for (unsigned i = 0; i < COUNT; i++) {
+      ASSERT_EQ(values[i], result[i])
+          << BITS << " bits, " << COUNT << " channels, channel " << i;
+    }
+  }
+}
+
+TEST(ChannelsPacker, LegacyEncoders)
+{
+  // CRSF, SBUS and Multi: 16 channels of 11 bits, each channel set to
+  // each value, the others being random
+  typedef ChannelsPacker<11, 16> Packer;
+  static_assert(Packer::FRAME_SIZE == 22, "Invalid frame size");
+
+  srand(11);
+  uint16_t values[16], result[16];
+  for (int i = 0; i < 16; i++) {
+    values[i] = rand() & 2047;
+  }
+
+  for (int channel = 0; channel < 16; channel++) {
+    for (uint16_t value = 0; value <= 2047; value++) {
+      values[channel] = value;
+      uint8_t frame[22], expected[22];
+      legacyPack(expected, values, 16, 11);
+      Packer::pack(frame, values);
+      ASSERT_EQ(0, memcmp(expected, frame, sizeof(frame)))
+          << "channel " << channel << " value " << value;
+
+      Packer::unpack(frame, result);
+      ASSERT_EQ(0, memcmp(values, result, sizeof(values)))
+          << "channel " << channel << " value " << value;
+    }
+    values[channel] = rand() & 2047;
+  }
+}
+
+TEST(ChannelsPacker, RoundTrip)
+{
+  checkRoundTrip<11, 16, CHANNELS_LSB_FIRST>();
+  checkRoundTrip<11, 16, CHANNELS_MSB_FIRST>();
+  checkRoundTrip<11, 8, CHANNELS_LSB_FIRST>();
+  checkRoundTrip<11, 8, CHANNELS_MSB_FIRST>();
+  checkRoundTrip<10, 12, CHANNELS_LSB_FIRST>();
+  checkRoundTrip<10, 12, CHANNELS_MSB_FIRST>();
+  checkRoundTrip<12, 16, CHANNELS_LSB_FIRST>();
+  checkRoundTrip<12, 16, CHANNELS_MSB_FIRST>();
+  checkRoundTrip<16, 8, CHANNELS_LSB_FIRST>();
+  checkRoundTrip<16, 8, CHANNELS_MSB_FIRST>();
+  checkRoundTrip<8, 5, CHANNELS_LSB_FIRST>();
+  checkRoundTrip<1, 9, CHANNELS_MSB_FIRST>();
+
+  // the last byte is incomplete
+  checkRoundTrip<11, 3, CHANNELS_LSB_FIRST>();
+  checkRoundTrip<11, 3, CHANNELS_MSB_FIRST>();
+  checkRoundTrip<13, 7, CHANNELS_LSB_FIRST>();
+  checkRoundTrip<15, 7, CHANNELS_MSB_FIRST>();
+}
+
+TEST(ChannelsPacker, Truncate)
+{
+  uint16_t values[2] = { 0xFFFF, 0 }, result[2];
+  uint8_t frame[3];
+  ChannelsPacker<11, 2>::pack(frame, values);
+  ChannelsPacker<11, 2>::unpack(frame, result);
+  EXPECT_EQ(2047, result[0]);
+  EXPECT_EQ(0, result[1]);
+}
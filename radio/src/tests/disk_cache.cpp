@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) EdgeTX
+ *
+ * Based on code named
+ *   opentx - https://github.com/opentx/opentx
+ *   th9x - http://code.google.com/p/th9x
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "gtests.h"
+
+#if defined(DISK_CACHE)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <vector>
+
+#include "disk_cache.h"
+
+#define TRACE_DISK_SECTORS  (1 << 16)
+#define TRACE_SECTOR_SIZE   FF_MAX_SS
+
+// Sectors never written hold a pattern derived from their number, the
+// first byte of the written ones is kept
+static std::map<DWORD, uint8_t> traceDiskWrites;
+static uint32_t traceDiskReads;
+static uint32_t traceDiskReadSectors;
+static uint32_t traceDiskWriteCalls;
+
+static uint8_t traceSectorByte(DWORD sector)
+{
+  return (uint8_t)(sector * 7);
+}
+
+static DRESULT traceDiskRead(BYTE, BYTE* buff, DWORD sector, UINT count)
+{
+  traceDiskReads++;
+  traceDiskReadSectors += count;
+  for (UINT s = 0; s < count; s++, buff += TRACE_SECTOR_SIZE) {
+    auto it = traceDiskWrites.find(sector + s);
+    buff[0] = it != traceDiskWrites.end() ? it->second
+                                          : traceSectorByte(sector + s);
+  }
+  return RES_OK;
+}
+
+static DRESULT traceDiskWrite(BYTE, const BYTE* buff, DWORD sector, UINT count)
+{
+  traceDiskWriteCalls++;
+  for (UINT s = 0; s < count; s++, buff += TRACE_SECTOR_SIZE) {
+    traceDiskWrites[sector + s] = buff[0];
+  }
+  return RES_OK;
+}
+
+static void traceDiskReset()
+{
+  traceDiskWrites.clear();
+  traceDiskReads = 0;
+  traceDiskReadSectors = 0;
+  traceDiskWriteCalls = 0;
+}
+
+static DRESULT traceDiskIoctl(BYTE, BYTE cmd, void* buff)
+{
+  if (cmd == CTRL_SYNC) return RES_OK;
+  if (cmd != GET_SECTOR_COUNT) return RES_PARERR;
+  *(DWORD*)buff = TRACE_DISK_SECTORS;
+  return RES_OK;
+}
+
+static const diskio_driver_t traceDiskDriver = {
+  .initialize = nullptr,
+  .deinit = nullptr,
+  .status = nullptr,
+  .read = traceDiskRead,
+  .write = traceDiskWrite,
+  .ioctl = traceDiskIoctl,
+};
+
+struct TraceAccess {
+  bool write;
+  DWORD sector;
+  UINT count;
+};
+
+// What playing a sound while loading a bitmap and writing a log looks
+// like: streams of small reads, FAT lookups at every cluster, and a few
+// directory updates
+static std::vector<TraceAccess> syntheticTrace()
+{
+  std::vector<TraceAccess> trace;
+  const DWORD fat = 32, dir = 1024;
+  DWORD wav = 4096, bitmap = 20000, log = 40000;
+
+  for (int i = 0; i < 400; i++) {
+    trace.push_back({false, wav, 2});
+    wav += 2;
+    if (wav % 8 == 0) trace.push_back({false, fat + wav / 1024, 1});
+
+    if (i < 200) {
+      trace.push_back({false, bitmap, 4});
+      bitmap += 4;
+      if (bitmap % 8 == 0) trace.push_back({false, fat + bitmap / 1024, 1});
+    }
+
+    if (i % 16 == 0) {
+      trace.push_back({true, log, 8});
+      trace.push_back({true, fat + log / 1024, 1});
+      trace.push_back({false, dir + (i % 4), 1});
+      trace.push_back({true, dir + (i % 4), 1});
+      log += 8;
+    }
+  }
+
+  return trace;
+}
+
+// Traces recorded with TRACE_DISK_CACHE enabled in disk_cache.cpp
+// ("r <sector> <count>" and "w <sector> <count>" lines)
+static bool loadTrace(const char* path, std::vector<TraceAccess>& trace)
+{
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    char op;
+    unsigned sector, count;
+    if (sscanf(line, " %c %u %u", &op, &sector, &count) == 3 &&
+        (op == 'r' || op == 'w')) {
+      trace.push_back({op == 'w', sector, count});
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+static void replayTrace(const std::vector<TraceAccess>& trace)
+{
+  DiskCache cache;
+  cache.initialize(&traceDiskDriver);
+  traceDiskReset();
+
+  // what each written sector should read back
+  std::map<DWORD, uint8_t> written;
+  static uint8_t buffer[64 * TRACE_SECTOR_SIZE];
+  uint32_t reads = 0, writes = 0;
+  for (const auto& access : trace) {
+    UINT count = std::min<UINT>(access.count, 64);
+    if (access.write) {
+      writes++;
+      for (UINT s = 0; s < count; s++) {
+        buffer[s * TRACE_SECTOR_SIZE] = written[access.sector + s] =
+            (uint8_t)(writes + s);
+      }
+      EXPECT_EQ(RES_OK, cache.write(0, buffer, access.sector, count));
+      continue;
+    }
+
+    reads++;
+    ASSERT_EQ(RES_OK, cache.read(0, buffer, access.sector, count));
+    for (UINT s = 0; s < count; s++) {
+      auto it = written.find(access.sector + s);
+      ASSERT_EQ(it != written.end() ? it->second
+                                    : traceSectorByte(access.sector + s),
+                buffer[s * TRACE_SECTOR_SIZE]);
+    }
+  }
+  EXPECT_EQ(RES_OK, cache.ioctl(0, CTRL_SYNC, nullptr));
+  EXPECT_EQ(written, traceDiskWrites);
+
+  const DiskCacheStats& stats = cache.getStats();
+  printf("%u reads: %u disk reads (%u sectors), hit rate %d%%o "
+         "(sequential %d%%o, random %d%%o), read ahead %u (%u used)\n",
+         reads, traceDiskReads, traceDiskReadSectors, cache.getHitRate(),
+         cache.getHitRate(DISK_CACHE_SEQUENTIAL),
+         cache.getHitRate(DISK_CACHE_RANDOM), stats.noReadAheads,
+         stats.noReadAheadHits);
+  printf("%u writes: %u disk writes\n", writes, traceDiskWriteCalls);
+}
+
+TEST(DiskCache, SyntheticTrace)
+{
+  // streams are mostly served from blocks read ahead
+  auto trace = syntheticTrace();
+  replayTrace(trace);
+  EXPECT_LT(traceDiskReads, 100U);
+}
+
+TEST(DiskCache, Streams)
+{
+  DiskCache cache;
+  cache.initialize(&traceDiskDriver);
+  traceDiskReset();
+
+  uint8_t buffer[2 * TRACE_SECTOR_SIZE];
+  for (DWORD sector = 1000; sector < 1000 + 3 * DISK_CACHE_BLOCK_SECTORS;
+       sector += 2) {
+    ASSERT_EQ(RES_OK, cache.read(0, buffer, sector, 2));
+    // unrelated reads do not break the stream
+    ASSERT_EQ(RES_OK, cache.read(0, buffer, 50 + (sector / 2) % 2, 1));
+  }
+
+  const DiskCacheStats& stats = cache.getStats();
+  // the stream start and the block holding the unrelated sectors,
+  // which is kept as it is used more recently than the stream blocks
+  EXPECT_EQ(2U, stats.noAccessMisses[DISK_CACHE_RANDOM]);
+  EXPECT_GE(stats.noReadAheads, 1U);
+  EXPECT_EQ(stats.noReadAheads, stats.noReadAheadHits);
+  EXPECT_GT(cache.getHitRate(DISK_CACHE_SEQUENTIAL), 900);
+
+  // a write invalidates whatever was read ahead
+  buffer[0] = 0xA5;
+  ASSERT_EQ(RES_OK, cache.write(0, buffer, 1041, 1));
+  ASSERT_EQ(RES_OK, cache.read(0, buffer, 1040, 2));
+  EXPECT_EQ(0xA5, buffer[TRACE_SECTOR_SIZE]);
+}
+
+#if defined(DISK_CACHE_WRITEBACK)
+TEST(DiskCache, WriteBack)
+{
+  DiskCache cache;
+  cache.initialize(&traceDiskDriver);
+  traceDiskReset();
+
+  // FAT and directory updates, a few times each
+  uint8_t buffer[TRACE_SECTOR_SIZE];
+  for (int i = 0; i < 3; i++) {
+    for (DWORD sector : {100, 101, 102, 50, 2000}) {
+      buffer[0] = (uint8_t)(sector + i);
+      ASSERT_EQ(RES_OK, cache.write(0, buffer, sector, 1));
+    }
+  }
+  EXPECT_EQ(0U, traceDiskWriteCalls);
+
+  // delayed writes are read back
+  ASSERT_EQ(RES_OK, cache.read(0, buffer, 101, 1));
+  EXPECT_EQ(101 + 2, buffer[0]);
+
+  // one write per run of adjacent sectors
+  ASSERT_EQ(RES_OK, cache.ioctl(0, CTRL_SYNC, nullptr));
+  EXPECT_EQ(3U, traceDiskWriteCalls);
+  EXPECT_EQ(100 + 2, traceDiskWrites[100]);
+  EXPECT_EQ((uint8_t)(2000 + 2), traceDiskWrites[2000]);
+  EXPECT_FALSE(cache.flushDue());
+}
+#endif
+
+TEST(DiskCache, RecordedTrace)
+{
+  const char* path = getenv("DISK_CACHE_TRACE");
+  std::vector<TraceAccess> trace;
+  if (!path || !loadTrace(path, trace)) {
+    GTEST_SKIP() << "set DISK_CACHE_TRACE to a recorded trace";
+  }
+  replayTrace(trace);
+}
+
+#endif
@@ -46,6 +46,40 @@ TEST(Storage, BackupAndRestore)
 }
 #endif
 
+TEST(Storage, WriteBehind)
+{
+  storageDirtyMsk = 0;
+  storageWritten(EE_MODEL, false);
+
+  // changes made in a row are written together once they settle
+  storageDirty(EE_MODEL);
+  g_tmr10ms += WRITE_DELAY_10MS / 2;
+  storageDirty(EE_GENERAL);
+  g_tmr10ms += WRITE_DELAY_10MS;
+  EXPECT_FALSE(storageWriteDue());  // too soon after the last write
+  g_tmr10ms += WRITE_INTERVAL_10MS;
+  EXPECT_TRUE(storageWriteDue());
+
+#if defined(SDCARD)
+  // held back while logs are written, but not forever
+  FATFS fs;
+  uint16_t deferred = storageWriteStats.deferred;
+  g_oLogFile.obj.fs = &fs;
+  EXPECT_FALSE(storageWriteDue());
+  EXPECT_FALSE(storageWriteDue());
+  EXPECT_EQ(deferred + 1, storageWriteStats.deferred);
+  g_tmr10ms += WRITE_MAX_DEFER_10MS;
+  EXPECT_TRUE(storageWriteDue());
+  g_oLogFile.obj.fs = nullptr;
+#endif
+
+  uint32_t writes = storageWriteStats.writes;
+  storageWritten(storageDirtyMsk, false);
+  storageDirtyMsk = 0;
+  EXPECT_EQ(writes + 1, storageWriteStats.writes);
+  EXPECT_FALSE(storageWriteDue());
+}
+
 #if defined(EEPROM) && defined(EEPROM_RLC)
 #include "storage/eeprom_rlc.h"
 
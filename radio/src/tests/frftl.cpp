@@ -0,0 +1,514 @@
+/*
+ * Copyright (C) EdgeTX
+ *
+ * Based on code named
+ *   opentx - https://github.com/opentx/opentx
+ *   th9x - http://code.google.com/p/th9x
+ *   er9x - http://code.google.com/p/er9x
+ *   gruvin9x - http://code.google.com/p/gruvin9x
+ *
+ * License GPLv2: http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "gtests.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "drivers/frftl.h"
+
+#define NOR_SIZE_MB          4
+#define NOR_ERASE_SIZE       4096
+#define NOR_PROGRAM_SIZE     256
+#define NOR_SECTOR_SIZE      512
+
+// Latency model, typical values of the SPI NOR flashes used on radios
+#define NOR_READ_US_PER_KB   25     // ~40MB/s in quad mode
+#define NOR_PROGRAM_US       700    // per 256 bytes page
+#define NOR_ERASE_US         45000  // per 4KB sector
+
+// RAM backed NOR flash: programming can only clear bits, erasing is done
+// by 4KB sectors, which are counted. A power failure can be scheduled
+// after a number of program / erase operations: the operation is left
+// half done and the flash does not respond until it is remounted.
+struct NorFlash {
+  std::vector<uint8_t> data;
+  std::vector<uint32_t> eraseCount;
+  uint64_t readBytes;
+  uint64_t programBytes;
+  uint32_t programs;
+  uint32_t erases;
+  uint32_t overprograms;  // 0 bits programmed to 1 (ignored by the flash)
+  uint64_t timeUs;
+  int32_t opsBeforeFailure;  // < 0: no failure scheduled
+  bool failed;
+
+  NorFlash() :
+    data(NOR_SIZE_MB * 1024 * 1024, 0xff),
+    eraseCount(data.size() / NOR_ERASE_SIZE, 0)
+  {
+    resetStats();
+    opsBeforeFailure = -1;
+    failed = false;
+  }
+
+  void resetStats()
+  {
+    readBytes = programBytes = 0;
+    programs = erases = overprograms = 0;
+    timeUs = 0;
+  }
+
+  enum { DONE, INTERRUPTED, POWERED_OFF };
+
+  // what happens to the next operation
+  int nextOperation()
+  {
+    if (failed) return POWERED_OFF;
+    if (opsBeforeFailure >= 0 && opsBeforeFailure-- == 0) {
+      failed = true;
+      return INTERRUPTED;
+    }
+    return DONE;
+  }
+
+  void powerUp()
+  {
+    opsBeforeFailure = -1;
+    failed = false;
+  }
+
+  uint32_t minEraseCount() const
+  {
+    return *std::min_element(eraseCount.begin(), eraseCount.end());
+  }
+
+  uint32_t maxEraseCount() const
+  {
+    return *std::max_element(eraseCount.begin(), eraseCount.end());
+  }
+};
+
+static NorFlash* norFlash;
+
+static bool norRead(uint32_t addr, uint8_t* buf, uint32_t len)
+{
+  if (norFlash->failed || addr + len > norFlash->data.size()) return false;
+  memcpy(buf, &norFlash->data[addr], len);
+  norFlash->readBytes += len;
+  norFlash->timeUs += (len * NOR_READ_US_PER_KB + 1023) / 1024;
+  return true;
+}
+
+static bool norProgram(uint32_t addr, const uint8_t* buf, uint32_t len)
+{
+  if (len % NOR_PROGRAM_SIZE != 0 || addr + len > norFlash->data.size())
+    return false;
+
+  for (uint32_t ofs = 0; ofs < len; ofs += NOR_PROGRAM_SIZE) {
+    int op = norFlash->nextOperation();
+    if (op == NorFlash::POWERED_OFF) return false;
+    // an interrupted operation is half done
+    uint32_t size = op == NorFlash::INTERRUPTED ? NOR_PROGRAM_SIZE / 2
+                                                : NOR_PROGRAM_SIZE;
+    uint8_t* p = &norFlash->data[addr + ofs];
+    for (uint32_t i = 0; i < size; i++) {
+      if (~p[i] & buf[ofs + i]) norFlash->overprograms++;
+      p[i] &= buf[ofs + i];
+    }
+    if (op == NorFlash::INTERRUPTED) return false;
+    norFlash->programs++;
+    norFlash->programBytes += NOR_PROGRAM_SIZE;
+    norFlash->timeUs += NOR_PROGRAM_US;
+  }
+  return true;
+}
+
+static bool norErase(uint32_t addr)
+{
+  if (addr % NOR_ERASE_SIZE != 0 || addr >= norFlash->data.size())
+    return false;
+
+  int op = norFlash->nextOperation();
+  if (op == NorFlash::POWERED_OFF) return false;
+  uint8_t* p = &norFlash->data[addr];
+  if (op == NorFlash::INTERRUPTED) {
+    memset(p, 0xff, NOR_ERASE_SIZE / 2);
+    return false;
+  }
+  memset(p, 0xff, NOR_ERASE_SIZE);
+  norFlash->eraseCount[addr / NOR_ERASE_SIZE]++;
+  norFlash->erases++;
+  norFlash->timeUs += NOR_ERASE_US;
+  return true;
+}
+
+static bool norIsErased(uint32_t addr)
+{
+  norFlash->readBytes += NOR_ERASE_SIZE;
+  norFlash->timeUs += NOR_ERASE_SIZE * NOR_READ_US_PER_KB / 1024;
+  for (uint32_t i = 0; i < NOR_ERASE_SIZE; i++) {
+    if (norFlash->data[addr + i] != 0xff) return false;
+  }
+  return true;
+}
+
+static const FrFTLOps norFlashOps = {
+  .flashRead = norRead,
+  .flashProgram = norProgram,
+  .flashErase = norErase,
+  .isFlashErased = norIsErased,
+};
+
+class FrFTLTest : public testing::Test
+{
+ protected:
+  NorFlash flash;
+  FrFTL ftl;
+  // version of the content of every sector, 0 if never written
+  std::vector<uint32_t> contents;
+  uint64_t hostSectors;
+  uint32_t hostSyncs;
+  uint64_t idleUs;  // flash busy with background work
+
+  void SetUp() override
+  {
+    norFlash = &flash;
+    ASSERT_TRUE(ftlInit(&ftl, &norFlashOps, NOR_SIZE_MB));
+    contents.assign(ftl.usableSectorCount, 0);
+    flash.resetStats();
+    hostSectors = 0;
+    hostSyncs = 0;
+    idleUs = 0;
+  }
+
+  void TearDown() override
+  {
+    ftlDeInit(&ftl);
+    norFlash = nullptr;
+  }
+
+  static void fillSector(uint8_t* buf, uint32_t sector, uint32_t version)
+  {
+    for (uint32_t i = 0; i < NOR_SECTOR_SIZE / 4; i++) {
+      ((uint32_t*)buf)[i] = sector * 0x10001 + version * 0x3779 + i;
+    }
+  }
+
+  bool write(uint32_t sector, uint32_t count = 1)
+  {
+    uint8_t buf[NOR_SECTOR_SIZE];
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t version = contents[sector + i] + 1;
+      fillSector(buf, sector + i, version);
+      if (!ftlWrite(&ftl, sector + i, 1, buf)) return false;
+      contents[sector + i] = version;
+      hostSectors++;
+    }
+    return true;
+  }
+
+  bool sync()
+  {
+    hostSyncs++;
+    return ftlSync(&ftl);
+  }
+
+  // what the radio does when not in use
+  void idle()
+  {
+    uint64_t start = flash.timeUs;
+    for (int i = 0; i < 1000 && ftlGarbageCollect(&ftl); i++) {
+    }
+    idleUs += flash.timeUs - start;
+  }
+
+  bool remount()
+  {
+    ftlDeInit(&ftl);
+    flash.powerUp();
+    return ftlInit(&ftl, &norFlashOps, NOR_SIZE_MB);
+  }
+
+  // sector content version, 0 for never written, -1 if unknown
+  int32_t readVersion(uint32_t sector, uint32_t maxVersion)
+  {
+    uint8_t buf[NOR_SECTOR_SIZE], expected[NOR_SECTOR_SIZE];
+    if (!ftlRead(&ftl, sector, buf)) return -1;
+    memset(expected, 0xff, sizeof(expected));
+    if (!memcmp(buf, expected, sizeof(buf))) return 0;
+    for (uint32_t version = 1; version <= maxVersion; version++) {
+      fillSector(expected, sector, version);
+      if (!memcmp(buf, expected, sizeof(buf))) return version;
+    }
+    return -1;
+  }
+
+  void checkContents()
+  {
+    for (uint32_t sector = 0; sector < contents.size(); sector++) {
+      ASSERT_EQ((int32_t)contents[sector],
+                readVersion(sector, contents[sector]))
+          << "sector " << sector;
+    }
+  }
+
+  void report(const char* workload)
+  {
+    double seconds = (flash.timeUs - idleUs) / 1e6;
+    printf("%s: %llu sectors written, %u syncs\n", workload,
+           (unsigned long long)hostSectors, hostSyncs);
+    printf("  write amplification %.2f, %u erases (per sector min %u max %u), "
+           "%.1f MB read\n",
+           (double)flash.programBytes / (hostSectors * NOR_SECTOR_SIZE),
+           flash.erases, flash.minEraseCount(), flash.maxEraseCount(),
+           flash.readBytes / 1e6);
+    printf("  flash busy %.2f s, %.0f sector writes/s", seconds,
+           seconds > 0 ? hostSectors / seconds : 0);
+    if (idleUs > 0) {
+      printf(", background %.2f s (%u erases, %u static pages moved)",
+             idleUs / 1e6, ftl.stats.backgroundErases,
+             ftl.stats.wearLevelingMoves);
+    }
+    printf("\n");
+    EXPECT_EQ(0U, flash.overprograms);
+  }
+
+  // FatFs rewriting a model file: its data, a FAT sector and a directory
+  // entry, then a sync. Returns the flash busy time.
+  uint64_t saveModel(uint32_t i)
+  {
+    const uint32_t fat = 32, dir = 96, model = 1024;
+    uint64_t start = flash.timeUs;
+    uint32_t file = model + (i % 3) * 16;
+    EXPECT_TRUE(write(file, 12));
+    EXPECT_TRUE(write(fat));
+    EXPECT_TRUE(write(dir + i % 3 / 2));
+    EXPECT_TRUE(sync());
+    return flash.timeUs - start;
+  }
+};
+
+TEST_F(FrFTLTest, YamlSaveBursts)
+{
+  uint64_t maxSaveUs = 0;
+  for (uint32_t i = 0; i < 300; i++) {
+    maxSaveUs = std::max(maxSaveUs, saveModel(i));
+  }
+  report("YAML save bursts");
+  printf("  longest save %.0f ms\n", maxSaveUs / 1e3);
+  checkContents();
+}
+
+// Same with the radio left idle between saves: the pages are erased
+// before they are needed
+TEST_F(FrFTLTest, YamlSaveBurstsWithGarbageCollection)
+{
+  uint64_t maxSaveUs = 0;
+  uint32_t foregroundErases = 0;
+  for (uint32_t i = 0; i < 300; i++) {
+    uint32_t erases = ftl.stats.erases;
+    maxSaveUs = std::max(maxSaveUs, saveModel(i));
+    foregroundErases += ftl.stats.erases - erases;
+    idle();
+  }
+  report("YAML save bursts, idle between saves");
+  printf("  longest save %.0f ms, %u erases while saving\n", maxSaveUs / 1e3,
+         foregroundErases);
+  EXPECT_EQ(0U, foregroundErases);
+  EXPECT_GT(ftlGetErasedPageCount(&ftl), 0);
+  checkContents();
+}
+
+// Static data fills most of the flash, a few files are saved over and
+// over: the pages holding the static data are worn as well
+TEST_F(FrFTLTest, WearLeveling)
+{
+  const uint32_t staticSectors = contents.size() * 3 / 4;
+  for (uint32_t sector = 2048; sector < staticSectors; sector += 64) {
+    ASSERT_TRUE(write(sector, std::min<uint32_t>(64, staticSectors - sector)));
+    ASSERT_TRUE(sync());
+  }
+
+  for (uint32_t i = 0; i < 3000; i++) {
+    saveModel(i);
+    idle();
+  }
+  report("Wear leveling");
+  EXPECT_GT(ftl.stats.wearLevelingMoves, 0U);
+  EXPECT_GT(flash.minEraseCount(), 0U);
+  checkContents();
+}
+
+// A log file growing by small records: the tail sector is rewritten at
+// every record, the FAT at every cluster, the directory entry at every sync
+TEST_F(FrFTLTest, LogStreaming)
+{
+  const uint32_t fat = 32, dir = 96, log = 2048;
+  const uint32_t recordsPerSector = 8;
+  for (uint32_t record = 0; record < 4000; record++) {
+    uint32_t sector = log + record / recordsPerSector;
+    ASSERT_TRUE(write(sector));
+    if (record % (8 * recordsPerSector) == 0) {
+      ASSERT_TRUE(write(fat));
+    }
+    if (record % 10 == 9) {
+      ASSERT_TRUE(write(dir));
+      ASSERT_TRUE(sync());
+    }
+  }
+  report("Log streaming");
+  checkContents();
+}
+
+TEST_F(FrFTLTest, RandomWrites)
+{
+  srand(0x5eed);
+  for (uint32_t i = 0; i < 4000; i++) {
+    ASSERT_TRUE(write(rand() % 4096));
+    if (i % 16 == 15) {
+      ASSERT_TRUE(sync());
+    }
+  }
+  report("Random 512B writes");
+  checkContents();
+}
+
+TEST_F(FrFTLTest, Remount)
+{
+  for (uint32_t i = 0; i < 50; i++) {
+    ASSERT_TRUE(write((i * 37) % 700, 3));
+  }
+  ASSERT_TRUE(sync());
+  ASSERT_TRUE(remount());
+  checkContents();
+}
+
+// The power is cut after every possible number of flash operations of a
+// sync: after a remount, each sector holds either its previous content
+// or the new one
+TEST_F(FrFTLTest, PowerFailure)
+{
+  const uint32_t sectors[] = {0, 1, 2, 9, 100, 101, 1000, 5000};
+  for (uint32_t sector : sectors) ASSERT_TRUE(write(sector));
+  ASSERT_TRUE(sync());
+
+  for (int32_t ops = 0;; ops++) {
+    std::vector<uint32_t> previous = contents;
+    flash.opsBeforeFailure = ops;
+    bool done = true;
+    for (uint32_t sector : sectors) done = done && write(sector);
+    done = done && sync();
+
+    ASSERT_TRUE(remount());
+    for (uint32_t sector : sectors) {
+      int32_t version = readVersion(sector, previous[sector] + 1);
+      if (done) {
+        ASSERT_EQ((int32_t)previous[sector] + 1, version)
+            << "sector " << sector;
+      } else {
+        ASSERT_TRUE(version == (int32_t)previous[sector] ||
+                    version == (int32_t)previous[sector] + 1)
+            << "power failure after " << ops << " operations, sector "
+            << sector << " version " << version;
+      }
+      contents[sector] = version;
+    }
+    if (done) break;
+  }
+}
+
+// A trim releasing more pages than the page buffer holds, on a full
+// flash: the released pages are the first ones reused by the next sync.
+// The power is cut after every possible number of flash operations of
+// that sync: the trimmed sectors are either still there or trimmed.
+TEST_F(FrFTLTest, PowerFailureAfterLargeTrim)
+{
+  // the trimmed pages hold a single sector: the whole page is released
+  // without being relocated, nor synced
+  const uint32_t start = 2048, count = 2048, rewritten = 16;
+  for (uint32_t sector = 0; sector < contents.size(); sector += 64) {
+    if (sector >= start && sector < start + count) {
+      for (uint32_t i = 0; i < 64; i += 8) ASSERT_TRUE(write(sector + i));
+    } else {
+      ASSERT_TRUE(
+          write(sector, std::min<uint32_t>(64, contents.size() - sector)));
+    }
+    ASSERT_TRUE(sync());
+  }
+  const std::vector<uint8_t> image = flash.data;
+  const std::vector<uint32_t> previous = contents;
+
+  for (int32_t ops = 0;; ops++) {
+    flash.data = image;
+    contents = previous;
+    ASSERT_TRUE(remount());
+    ASSERT_TRUE(ftlTrim(&ftl, start, count));
+    idle();
+
+    flash.opsBeforeFailure = ops;
+    bool done = write(0, rewritten) && sync();
+
+    ASSERT_TRUE(remount());
+    for (uint32_t sector = start; sector < start + count; sector++) {
+      int32_t version = readVersion(sector, previous[sector]);
+      ASSERT_TRUE(version == 0 || version == (int32_t)previous[sector])
+          << "power failure after " << ops << " operations, sector "
+          << sector << " version " << version;
+      contents[sector] = version;
+    }
+    for (uint32_t sector = 0; sector < rewritten; sector++) {
+      int32_t version = readVersion(sector, 2);
+      ASSERT_TRUE(version == 2 || (!done && version == 1))
+          << "power failure after " << ops << " operations, sector "
+          << sector;
+      contents[sector] = version;
+    }
+    checkContents();
+    if (done) break;
+  }
+}
+
+// A sync failing after every possible number of flash operations, the
+// flash still responding afterwards: the garbage collection does not
+// erase the pages of the committed MTT before it is replaced
+TEST_F(FrFTLTest, GarbageCollectionAfterFailedSync)
+{
+  const uint32_t sectors[] = {0, 1, 2, 9, 100, 101, 1000, 5000};
+  for (uint32_t sector : sectors) ASSERT_TRUE(write(sector));
+  ASSERT_TRUE(sync());
+
+  for (int32_t ops = 0;; ops++) {
+    std::vector<uint32_t> previous = contents;
+    flash.opsBeforeFailure = ops;
+    bool done = true;
+    for (uint32_t sector : sectors) done = done && write(sector);
+    done = done && sync();
+    flash.powerUp();
+    idle();
+
+    ASSERT_TRUE(remount());
+    for (uint32_t sector : sectors) {
+      int32_t version = readVersion(sector, previous[sector] + 1);
+      ASSERT_TRUE(version == (int32_t)previous[sector] + 1 ||
+                  (!done && version == (int32_t)previous[sector]))
+          << "sync failed after " << ops << " operations, sector " << sector
+          << " version " << version;
+      contents[sector] = version;
+    }
+    if (done) break;
+  }
+  checkContents();
+}
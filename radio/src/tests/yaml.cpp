@@ -68,3 +68,275 @@ TEST(Yaml, SkipBlankLines)
   EXPECT_EQ(YamlParser::CONTINUE_PARSING, yp.parse(chunk_3, sizeof(chunk_3) - 1));
   EXPECT_EQ(45, t.foo);
 }
+
+TEST(Yaml, KeysOutOfOrder)
+{
+  TestStruct t;
+
+  YamlTreeWalker tree;
+  tree.reset(&_root_node, (uint8_t*)&t);
+
+  // unknown keys and keys before the last one found must still be found
+  const char chunk[] = "testStruct:\n  bar: 34\n  baz: 1\n  foo: 12\n";
+
+  YamlParser yp;
+  yp.init(YamlTreeWalker::get_parser_calls(), &tree);
+  yp.set_eof();
+  EXPECT_EQ(YamlParser::CONTINUE_PARSING, yp.parse(chunk, sizeof(chunk) - 1));
+  EXPECT_EQ(12, t.foo);
+  EXPECT_EQ(34, t.bar);
+}
+
+#if defined(SDCARD_YAML)
+#include <chrono>
+#include <string>
+#include <storage/yaml/yaml_datastructs.h>
+#include <storage/sdcard_yaml.h>
+
+#define YAML_BENCH_MODEL   "bench.yml"
+#define YAML_BENCH_LOOPS   100
+
+static void writeBenchModel(const char* name = "Bench")
+{
+  simuFatfsSetPaths(TESTS_BUILD_PATH "/", TESTS_BUILD_PATH "/");
+  sdCheckAndCreateDirectory(MODELS_PATH);
+
+  MODEL_RESET();
+  setModelDefaults();
+  strcpy(g_model.header.name, name);
+  for (int i = 0; i < MAX_MIXERS; i++) {
+    g_model.mixData[i].destCh = i % MAX_OUTPUT_CHANNELS;
+    g_model.mixData[i].srcRaw = MIXSRC_FIRST_STICK + i % 4;
+    g_model.mixData[i].weight = 100 - i;
+  }
+  EXPECT_EQ(nullptr, writeModelYaml(YAML_BENCH_MODEL));
+}
+
+// saves g_model the way writeModelYaml() does, leaving its snapshot alone
+static const char* rewriteBenchModel()
+{
+  char path[256];
+  getModelPath(path, YAML_BENCH_MODEL);
+  return writeFileYaml(path, get_modeldata_nodes(), (uint8_t *)&g_model, 0);
+}
+
+static bool statBenchModel(FILINFO* fno)
+{
+  return f_stat(MODELS_PATH "/" YAML_BENCH_MODEL, fno) == FR_OK;
+}
+
+static void removeBenchModel()
+{
+  removeModelCache(YAML_BENCH_MODEL);
+  f_unlink(MODELS_PATH "/" YAML_BENCH_MODEL);
+  simuFatfsSetPaths("", "");
+}
+
+// A model spanning several read buffers loads back unchanged
+TEST(Yaml, ReadModelSpanningBuffers)
+{
+  writeBenchModel();
+
+  auto model = (ModelData *)malloc(sizeof(ModelData));
+  ASSERT_NE(nullptr, model);
+
+  removeModelCache(YAML_BENCH_MODEL);
+  EXPECT_EQ(nullptr, readModelYaml(YAML_BENCH_MODEL, (uint8_t *)model,
+                                   sizeof(ModelData)));
+  EXPECT_STREQ("Bench", model->header.name);
+  for (int i = 0; i < MAX_MIXERS; i++) {
+    EXPECT_EQ(g_model.mixData[i].weight, model->mixData[i].weight);
+  }
+
+  free(model);
+  removeBenchModel();
+}
+
+// Times the model loads, with and without the snapshot (on the target,
+// see debugTimerYamlRead with DEBUG_TIMERS)
+TEST(Yaml, ReadModelBenchmark)
+{
+  writeBenchModel();
+
+  auto model = (ModelData *)malloc(sizeof(ModelData));
+  ASSERT_NE(nullptr, model);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < YAML_BENCH_LOOPS; i++) {
+    removeModelCache(YAML_BENCH_MODEL);
+    EXPECT_EQ(nullptr, readModelYaml(YAML_BENCH_MODEL, (uint8_t *)model,
+                                     sizeof(ModelData)));
+  }
+  auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+  printf("readModelYaml(): %d us\n", (int)(duration.count() / YAML_BENCH_LOOPS));
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < YAML_BENCH_LOOPS; i++) {
+    EXPECT_EQ(nullptr, readModelYaml(YAML_BENCH_MODEL, (uint8_t *)model,
+                                     sizeof(ModelData)));
+  }
+  duration = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+  printf("readModelYaml() from cache: %d us\n",
+         (int)(duration.count() / YAML_BENCH_LOOPS));
+
+  free(model);
+  removeBenchModel();
+}
+
+TEST(Yaml, ModelCache)
+{
+  writeBenchModel("Cached");
+
+  auto model = (ModelData *)malloc(sizeof(ModelData));
+  ASSERT_NE(nullptr, model);
+
+  // a YAML load writes the snapshot
+  removeModelCache(YAML_BENCH_MODEL);
+  EXPECT_EQ(nullptr, readModelYaml(YAML_BENCH_MODEL, (uint8_t *)model,
+                                   sizeof(ModelData)));
+  FILINFO fno;
+  EXPECT_EQ(FR_OK, f_stat(MODELS_CACHE_PATH "/bench" MODELS_CACHE_EXT, &fno));
+  EXPECT_STREQ("Cached", model->header.name);
+
+  // the YAML file is changed behind our back, keeping its size: the
+  // snapshot must be ignored
+  strcpy(g_model.header.name, "Cachee");
+  EXPECT_EQ(nullptr, rewriteBenchModel());
+  EXPECT_EQ(nullptr, readModelYaml(YAML_BENCH_MODEL, (uint8_t *)model,
+                                   sizeof(ModelData)));
+  EXPECT_STREQ("Cachee", model->header.name);
+
+  free(model);
+  removeBenchModel();
+}
+
+TEST(Yaml, WriteRecovery)
+{
+  writeBenchModel("Atomic");
+
+  // date the file back: rewriting it would date it from now
+  FILINFO old;
+  ASSERT_TRUE(statBenchModel(&old));
+  old.fdate = (20 << 9) | (1 << 5) | 1;  // 2000-01-01
+  old.ftime = 0;
+  char path[256];
+  getModelPath(path, YAML_BENCH_MODEL);
+  ASSERT_EQ(FR_OK, f_utime(path, &old));
+
+  // writing the same model again leaves the file alone
+  FILINFO fno;
+  EXPECT_EQ(nullptr, rewriteBenchModel());
+  ASSERT_TRUE(statBenchModel(&fno));
+  EXPECT_EQ(old.fdate, fno.fdate);
+  EXPECT_EQ(old.ftime, fno.ftime);
+  EXPECT_NE(FR_OK, f_stat(MODELS_PATH "/" YAML_BENCH_MODEL ".tmp", &fno));
+
+  // while any change is written
+  strcpy(g_model.header.name, "Atomix");
+  EXPECT_EQ(nullptr, rewriteBenchModel());
+  ASSERT_TRUE(statBenchModel(&fno));
+  EXPECT_NE(old.fdate, fno.fdate);
+
+  // power loss between removing the file and renaming the new one
+  removeModelCache(YAML_BENCH_MODEL);
+  EXPECT_EQ(FR_OK, f_rename(path, MODELS_PATH "/" YAML_BENCH_MODEL ".tmp"));
+
+  auto model = (ModelData *)malloc(sizeof(ModelData));
+  ASSERT_NE(nullptr, model);
+  EXPECT_EQ(nullptr, readModelYaml(YAML_BENCH_MODEL, (uint8_t *)model,
+                                   sizeof(ModelData)));
+  EXPECT_STREQ("Atomix", model->header.name);
+  EXPECT_TRUE(statBenchModel(&fno));
+
+  free(model);
+  removeBenchModel();
+}
+
+static bool yaml_string_writer(void* opaque, const char* str, size_t len)
+{
+  ((std::string*)opaque)->append(str, len);
+  return true;
+}
+
+// The YAML text of a fully populated model
+static std::string generateBenchModelText()
+{
+  MODEL_RESET();
+  setModelDefaults();
+  for (int i = 0; i < MAX_MIXERS; i++) {
+    g_model.mixData[i].destCh = i % MAX_OUTPUT_CHANNELS;
+    g_model.mixData[i].srcRaw = MIXSRC_FIRST_STICK + i % 4;
+    g_model.mixData[i].weight = 100 - i;
+  }
+  for (int i = 0; i < MAX_EXPOS; i++) {
+    g_model.expoData[i].mode = 3;
+    g_model.expoData[i].chn = i % MAX_INPUTS;
+    g_model.expoData[i].srcRaw = MIXSRC_FIRST_STICK + i % 4;
+    g_model.expoData[i].weight = 100 - i;
+  }
+
+  std::string text;
+  YamlTreeWalker tree;
+  tree.reset(get_modeldata_nodes(), (uint8_t*)&g_model);
+  tree.generate(yaml_string_writer, &text);
+  return text;
+}
+
+static void parseModelText(const std::string& text, ModelData* model)
+{
+  memset(model, 0, sizeof(ModelData));
+  YamlTreeWalker tree;
+  tree.reset(get_modeldata_nodes(), (uint8_t*)model);
+  YamlParser yp;
+  yp.init(YamlTreeWalker::get_parser_calls(), &tree);
+  yp.set_eof();
+  EXPECT_NE(YamlParser::STRING_OVERFLOW, yp.parse(text.c_str(), text.size()));
+}
+
+// Every attribute of a fully populated model is found by the tag lookups
+TEST(Yaml, ParseModel)
+{
+  std::string text = generateBenchModelText();
+  ASSERT_FALSE(text.empty());
+
+  auto model = (ModelData *)malloc(sizeof(ModelData));
+  ASSERT_NE(nullptr, model);
+
+  parseModelText(text, model);
+  for (int i = 0; i < MAX_MIXERS; i++) {
+    EXPECT_EQ(g_model.mixData[i].destCh, model->mixData[i].destCh);
+    EXPECT_EQ(g_model.mixData[i].srcRaw, model->mixData[i].srcRaw);
+    EXPECT_EQ(g_model.mixData[i].weight, model->mixData[i].weight);
+  }
+  for (int i = 0; i < MAX_EXPOS; i++) {
+    EXPECT_EQ(g_model.expoData[i].chn, model->expoData[i].chn);
+    EXPECT_EQ(g_model.expoData[i].srcRaw, model->expoData[i].srcRaw);
+    EXPECT_EQ(g_model.expoData[i].weight, model->expoData[i].weight);
+  }
+
+  free(model);
+}
+
+// Times the tree walker without any file system access
+TEST(Yaml, ParseModelBenchmark)
+{
+  std::string text = generateBenchModelText();
+  ASSERT_FALSE(text.empty());
+
+  auto model = (ModelData *)malloc(sizeof(ModelData));
+  ASSERT_NE(nullptr, model);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < YAML_BENCH_LOOPS; i++) {
+    parseModelText(text, model);
+  }
+  auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+  printf("parse %d bytes: %d us\n", (int)text.size(),
+         (int)(duration.count() / YAML_BENCH_LOOPS));
+
+  free(model);
+}
+#endif
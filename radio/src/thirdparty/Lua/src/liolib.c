@@ -254,6 +254,8 @@ static int io_open (lua_State *L) {
   if (result == FR_OK) {
     if (*md == 'a')
       f_lseek(&p->f, f_size(&p->f));   // seek to the end of the file
+    if (mode & FA_WRITE)
+      lua__fileWritten(filename);
     return 1;
   }
   else {
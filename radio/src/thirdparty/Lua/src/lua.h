@@ -417,6 +417,7 @@ struct lua_Debug {
 #if defined(USE_FATFS)
   #include "FatFs/ff.h"
   int lua__getc(FIL *f);
+  void lua__fileWritten(const char *filename);
   #define lua_getc(f) lua__getc(&f)
   #define lua_fclose  f_close
 #else
@@ -627,6 +627,7 @@ const char STR_TELEMETRY_SENSORS[] = TR_TELEMETRY_SENSORS;
 const char STR_VALUE[] = TR_VALUE;
 const char STR_PERIOD[] = TR_PERIOD;
 const char STR_INTERVAL[] = TR_INTERVAL;
+const char STR_LOGS_FAST_RATE[] = TR_LOGS_FAST_RATE;
 const char STR_REPEAT[] = TR_REPEAT;
 const char STR_ENABLE[] = TR_ENABLE;
 const char STR_DISABLE[] = TR_DISABLE;
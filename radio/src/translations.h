@@ -955,6 +955,11 @@ const LanguagePack * const languagePacks[] = {
 
 #define PLAY_FUNCTION(x, ...)    void x(__VA_ARGS__, uint8_t id, int8_t fragmentVolume = USE_SETTINGS_VOLUME)
 
+#if defined(AUDIO_PHRASE_CACHE)
+// in audio.cpp, the phrases are cached
+PLAY_FUNCTION(playNumber, getvalue_t number, uint8_t unit, uint8_t flags);
+PLAY_FUNCTION(playDuration, int seconds, uint8_t flags);
+#else
 inline PLAY_FUNCTION(playNumber, getvalue_t number, uint8_t unit, uint8_t flags) {
   currentLanguagePack->playNumber(number, unit, flags, id, fragmentVolume);
 }
@@ -962,6 +967,7 @@ inline PLAY_FUNCTION(playNumber, getvalue_t number, uint8_t unit, uint8_t flags)
 inline PLAY_FUNCTION(playDuration, int seconds, uint8_t flags) {
    currentLanguagePack->playDuration(seconds, flags, id, fragmentVolume);
 }
+#endif
 
 extern const char STR_MODELNAME[];
 extern const char STR_PHASENAME[];
@@ -1030,6 +1036,7 @@ extern const char STR_TELEMETRY_SENSORS[];
 extern const char STR_VALUE[];
 extern const char STR_PERIOD[];
 extern const char STR_INTERVAL[];
+extern const char STR_LOGS_FAST_RATE[];
 extern const char STR_REPEAT[];
 extern const char STR_ENABLE[];
 extern const char STR_DISABLE[];
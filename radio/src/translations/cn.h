@@ -865,6 +865,7 @@
 #define TR_VALUE                       "数值"
 #define TR_PERIOD                      "周期"
 #define TR_INTERVAL                    "间隔"
+#define TR_LOGS_FAST_RATE              "Sticks/Ch. rate"
 #define TR_REPEAT                      "循环"
 #define TR_ENABLE                      "启用"
 #define TR_DISABLE                     "Disable"
@@ -881,6 +881,7 @@
 #define TR_VALUE                       "Hodnota"
 #define TR_PERIOD                      "Perioda"
 #define TR_INTERVAL                    "Interval"
+#define TR_LOGS_FAST_RATE              "Sticks/Ch. rate"
 #define TR_REPEAT                      "Opakovat"
 #define TR_ENABLE                      "Povoleno"
 #define TR_DISABLE                     "Zakazano"
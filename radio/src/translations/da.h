@@ -880,6 +880,7 @@
 #define TR_VALUE                       "Værdi"
 #define TR_PERIOD                      "Periode"
 #define TR_INTERVAL                    "Interval"
+#define TR_LOGS_FAST_RATE              "Sticks/Ch. rate"
 #define TR_REPEAT                      "Gentag"
 #define TR_ENABLE                      "Aktiver"
 #define TR_DISABLE                     "Deaktiver"
@@ -875,6 +875,7 @@
 #define TR_VALUE               		   "Wert"
 #define TR_PERIOD                    "Periode"
 #define TR_INTERVAL                  "Intervall"
+#define TR_LOGS_FAST_RATE            "Knüppel/Kan. Rate"
 #define TR_REPEAT                      "Wiederholung"
 #define TR_ENABLE                      "Aktivieren"
 #define TR_DISABLE                     "Deaktivieren"
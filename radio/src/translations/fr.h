@@ -878,6 +878,7 @@
 #define TR_VALUE                       "Valeur"
 #define TR_PERIOD                      "Période"
 #define TR_INTERVAL                    "Intervalle"
+#define TR_LOGS_FAST_RATE              "Fréq. manches/voies"
 #define TR_REPEAT                      "Répéter"
 #define TR_ENABLE                      "Activer"
 #define TR_DISABLE                     "Désactiver"
@@ -879,6 +879,7 @@
 #define TR_VALUE                       "ערך"
 #define TR_PERIOD                      "Period"
 #define TR_INTERVAL                    "Interval"
+#define TR_LOGS_FAST_RATE              "Sticks/Ch. rate"
 #define TR_REPEAT                      "מספר חזרות"
 #define TR_ENABLE                      "זמין"
 #define TR_DISABLE                     "אל תאפשר"
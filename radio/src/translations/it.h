@@ -874,6 +874,7 @@
 #define TR_VALUE                        "Valore"
 #define TR_PERIOD                       "Periodo"
 #define TR_INTERVAL                     "Intervallo"
+#define TR_LOGS_FAST_RATE               "Freq. stick/canali"
 #define TR_REPEAT                       "Ripeti"
 #define TR_ENABLE                       "Abilita"
 #define TR_DISABLE                      "Disabilita"
@@ -870,6 +870,7 @@
 #define TR_VALUE                       "値"
 #define TR_PERIOD                      "ピリオド"
 #define TR_INTERVAL                    "インターバル"
+#define TR_LOGS_FAST_RATE              "Sticks/Ch. rate"
 #define TR_REPEAT                      "リピート"
 #define TR_ENABLE                      "有効"
 #define TR_DISABLE                     "Disable"
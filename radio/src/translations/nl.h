@@ -871,6 +871,7 @@
 #define TR_VALUE               "Waarde"
 #define TR_PERIOD              "Period"
 #define TR_INTERVAL            "Interval"
+#define TR_LOGS_FAST_RATE      "Sticks/Ch. rate"
 #define TR_REPEAT              "Repeat"
 #define TR_ENABLE              "Enable"
 #define TR_DISABLE             "Disable"
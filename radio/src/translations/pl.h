@@ -867,6 +867,7 @@
 #define TR_VALUE               "Wartość"
 #define TR_PERIOD              "Okres"
 #define TR_INTERVAL            "Interwał"
+#define TR_LOGS_FAST_RATE      "Sticks/Ch. rate"
 #define TR_REPEAT              "Powtórz"
 #define TR_ENABLE              "Włącz"
 #define TR_DISABLE             "Wyłączać"
@@ -877,6 +877,7 @@
 #define TR_VALUE                       "Значен"
 #define TR_PERIOD                      "Период"
 #define TR_INTERVAL                    "Интервал"
+#define TR_LOGS_FAST_RATE              "Sticks/Ch. rate"
 #define TR_REPEAT                      "Повтор"
 #define TR_ENABLE                      "Включено"
 #define TR_DISABLE                     "Выключено"
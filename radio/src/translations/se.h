@@ -896,6 +896,7 @@
 #define TR_VALUE                        "Värde"
 #define TR_PERIOD                       "Period"
 #define TR_INTERVAL                     "Intervall"
+#define TR_LOGS_FAST_RATE               "Sticks/Ch. rate"
 #define TR_REPEAT                       "Upprepa"
 #define TR_ENABLE                       "Aktivera"
 #define TR_DISABLE                      "Inaktivera"
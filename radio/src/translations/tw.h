@@ -870,6 +870,7 @@
 #define TR_VALUE                       "數值"
 #define TR_PERIOD                      "週期"
 #define TR_INTERVAL                    "間隔"
+#define TR_LOGS_FAST_RATE              "Sticks/Ch. rate"
 #define TR_REPEAT                      "循環"
 #define TR_ENABLE                      "啟用"
 #define TR_DISABLE                     "Disable"
@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# This program converts EdgeTX binary logs (.etl) into the CSV format
+# written by the radio (see radio/src/logs_binary.h for the file layout)
+
+import argparse
+import datetime
+import struct
+import sys
+
+LOGS_BINARY_MAGIC = b"ETXL"
+LOGS_BINARY_VERSION = 2
+LOGS_BINARY_FLAG_RTC = 0x01
+
+LOG_COLUMN_INT8 = 0
+LOG_COLUMN_INT16 = 1
+LOG_COLUMN_INT32 = 2
+LOG_COLUMN_GPS = 3
+LOG_COLUMN_DATETIME = 4
+LOG_COLUMN_TEXT = 5
+LOG_COLUMN_BITS64 = 6
+
+LOG_COLUMN_TEXT_LENGTH = 16
+
+column_formats = {
+    LOG_COLUMN_INT8: "<b",
+    LOG_COLUMN_INT16: "<h",
+    LOG_COLUMN_INT32: "<i",
+    LOG_COLUMN_GPS: "<ii",
+    LOG_COLUMN_DATETIME: "<HBBBBBx",
+    LOG_COLUMN_TEXT: "<%ds" % LOG_COLUMN_TEXT_LENGTH,
+    LOG_COLUMN_BITS64: "<Q",
+}
+
+
+def format_decimal(value, precision):
+    if precision == 0:
+        return "%d" % value
+    sign = "-" if value < 0 else ""
+    quot, rem = divmod(abs(value), 10 ** precision)
+    return "%s%d.%0*d" % (sign, quot, precision, rem)
+
+
+def format_value(column_type, precision, values):
+    if column_type in (LOG_COLUMN_INT8, LOG_COLUMN_INT16, LOG_COLUMN_INT32):
+        return format_decimal(values[0], precision)
+    if column_type == LOG_COLUMN_GPS:
+        latitude, longitude = values
+        if latitude == 0 or longitude == 0:
+            return ""
+        return "%s %s" % (format_decimal(latitude, 6), format_decimal(longitude, 6))
+    if column_type == LOG_COLUMN_DATETIME:
+        return "%04d-%02d-%02d %02d:%02d:%02d" % values
+    if column_type == LOG_COLUMN_TEXT:
+        return '"%s"' % values[0].split(b"\0")[0].decode("utf-8", "replace")
+    if column_type == LOG_COLUMN_BITS64:
+        return "0x%016X" % values[0]
+    raise ValueError("unknown column type %d" % column_type)
+
+
+def read_header(data):
+    magic, version, flags, count, group_count, header_size, start_time = \
+        struct.unpack_from("<4sBBHHHI", data, 0)
+    if magic != LOGS_BINARY_MAGIC:
+        raise ValueError("not an EdgeTX binary log")
+    if version > LOGS_BINARY_VERSION:
+        raise ValueError("unsupported log version %d" % version)
+
+    # version 1: no group, 'group_count' is the record size
+    column_format = "<BBBB" if version >= 2 else "<BBB"
+
+    columns = []
+    offset = struct.calcsize("<4sBBHHHI")
+    for _ in range(count):
+        if version >= 2:
+            column_type, precision, group, name_length = \
+                struct.unpack_from(column_format, data, offset)
+        else:
+            column_type, precision, name_length = \
+                struct.unpack_from(column_format, data, offset)
+            group = 0
+        offset += struct.calcsize(column_format)
+        name = data[offset:offset + name_length].decode("utf-8", "replace")
+        offset += name_length
+        columns.append((name, column_type, precision, group))
+
+    if not flags & LOGS_BINARY_FLAG_RTC:
+        start_time = 0
+
+    return version, columns, header_size, start_time
+
+
+def convert(data, output):
+    version, columns, header_size, start_time = read_header(data)
+    start = datetime.datetime(1970, 1, 1) + datetime.timedelta(seconds=start_time)
+
+    output.write(",".join(["Date", "Time"] + [c[0] for c in columns]) + "\n")
+
+    record_sizes = {}
+    for name, column_type, precision, group in columns:
+        size = struct.calcsize(column_formats[column_type])
+        record_sizes[group] = record_sizes.get(group, 0) + size
+
+    # columns of the other groups keep their last value
+    row = [""] * len(columns)
+    offset = header_size
+    while True:
+        group = 0
+        if version >= 2:
+            if offset >= len(data):
+                break
+            (group,) = struct.unpack_from("<B", data, offset)
+            offset += 1
+        if group not in record_sizes or \
+                offset + 4 + record_sizes[group] > len(data):
+            break
+        (timestamp,) = struct.unpack_from("<I", data, offset)
+        offset += 4
+        for index, (name, column_type, precision, column_group) in enumerate(columns):
+            if column_group != group:
+                continue
+            fmt = column_formats[column_type]
+            values = struct.unpack_from(fmt, data, offset)
+            offset += struct.calcsize(fmt)
+            row[index] = format_value(column_type, precision, values)
+        time = start + datetime.timedelta(milliseconds=timestamp)
+        date = time.strftime("%Y-%m-%d")
+        clock = time.strftime("%H:%M:%S.") + "%03d" % (time.microsecond // 1000)
+        output.write(",".join([date, clock] + row) + "\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert EdgeTX binary logs to CSV")
+    parser.add_argument("input", help="binary log file (.etl)")
+    parser.add_argument("output", nargs="?", help="CSV output file (default: stdout)")
+    args = parser.parse_args()
+
+    with open(args.input, "rb") as f:
+        data = f.read()
+
+    if args.output:
+        with open(args.output, "w") as output:
+            convert(data, output)
+    else:
+        convert(data, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
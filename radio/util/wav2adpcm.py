@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+# This program converts 16 bits PCM WAV files (sound packs) into mono
+# IMA-ADPCM WAV files, 4 times smaller, which the radio plays as they are
+# (see WavContext::readSamples() in radio/src/audio.cpp)
+
+import argparse
+import os
+import struct
+import sys
+import wave
+
+WAVE_FORMAT_IMA_ADPCM = 0x11
+BLOCK_ALIGN = 256
+SAMPLES_PER_BLOCK = (BLOCK_ALIGN - 4) * 2 + 1
+
+STEPS = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41,
+    45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209,
+    230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876,
+    963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749,
+    3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630,
+    9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385,
+    24623, 27086, 29794, 32767
+]
+
+INDEXES = [-1, -1, -1, -1, 2, 4, 6, 8]
+
+
+class Encoder:
+    def __init__(self):
+        self.predictor = 0
+        self.index = 0
+
+    def encode(self, sample):
+        step = STEPS[self.index]
+        diff = sample - self.predictor
+        nibble = 0
+        if diff < 0:
+            nibble = 8
+            diff = -diff
+        # same rounding as the decoder
+        delta = step >> 3
+        if diff >= step:
+            nibble |= 4
+            diff -= step
+            delta += step
+        if diff >= step >> 1:
+            nibble |= 2
+            diff -= step >> 1
+            delta += step >> 1
+        if diff >= step >> 2:
+            nibble |= 1
+            delta += step >> 2
+        if nibble & 8:
+            delta = -delta
+        self.predictor = max(-32768, min(32767, self.predictor + delta))
+        self.index = max(0, min(len(STEPS) - 1, self.index + INDEXES[nibble & 7]))
+        return nibble
+
+    def block(self, samples):
+        # the header holds the first sample, the step index is kept
+        # from the previous block
+        self.predictor = samples[0]
+        data = bytearray(struct.pack("<hBB", samples[0], self.index, 0))
+        nibbles = [self.encode(sample) for sample in samples[1:]]
+        if len(nibbles) % 2:
+            nibbles.append(0)
+        for i in range(0, len(nibbles), 2):
+            data.append(nibbles[i] | (nibbles[i + 1] << 4))
+        return data
+
+
+def read_samples(path):
+    with wave.open(path, "rb") as f:
+        if f.getsampwidth() != 2:
+            raise ValueError("only 16 bits PCM files can be converted")
+        channels = f.getnchannels()
+        rate = f.getframerate()
+        frames = f.readframes(f.getnframes())
+    samples = struct.unpack("<%dh" % (len(frames) // 2), frames)
+    if channels > 1:
+        # mixed down to mono
+        samples = [sum(samples[i:i + channels]) // channels
+                   for i in range(0, len(samples), channels)]
+    return rate, list(samples)
+
+
+def write_adpcm(path, rate, samples):
+    encoder = Encoder()
+    data = bytearray()
+    for i in range(0, len(samples), SAMPLES_PER_BLOCK):
+        data += encoder.block(samples[i:i + SAMPLES_PER_BLOCK])
+
+    fmt = struct.pack("<HHIIHHHH", WAVE_FORMAT_IMA_ADPCM, 1, rate,
+                      rate * BLOCK_ALIGN // SAMPLES_PER_BLOCK, BLOCK_ALIGN, 4,
+                      2, SAMPLES_PER_BLOCK)
+    fact = struct.pack("<I", len(samples))
+    chunks = (b"fmt " + struct.pack("<I", len(fmt)) + fmt +
+              b"fact" + struct.pack("<I", len(fact)) + fact +
+              b"data" + struct.pack("<I", len(data)) + data)
+    if len(data) % 2:
+        chunks += b"\0"
+
+    with open(path, "wb") as f:
+        f.write(b"RIFF" + struct.pack("<I", len(chunks) + 4) + b"WAVE")
+        f.write(chunks)
+
+
+def convert(src, dst):
+    rate, samples = read_samples(src)
+    if not samples:
+        raise ValueError("no samples")
+    write_adpcm(dst, rate, samples)
+    return os.path.getsize(src), os.path.getsize(dst)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Convert WAV sound files to IMA-ADPCM")
+    parser.add_argument("input", help="WAV file or directory (sound pack)")
+    parser.add_argument("output", help="output file or directory")
+    args = parser.parse_args()
+
+    if os.path.isdir(args.input):
+        files = []
+        for root, dirs, names in os.walk(args.input):
+            for name in names:
+                if name.lower().endswith(".wav"):
+                    src = os.path.join(root, name)
+                    files.append((src, os.path.join(
+                        args.output, os.path.relpath(src, args.input))))
+    else:
+        files = [(args.input, args.output)]
+
+    total_in = total_out = 0
+    for src, dst in sorted(files):
+        os.makedirs(os.path.dirname(dst) or ".", exist_ok=True)
+        try:
+            size_in, size_out = convert(src, dst)
+        except (ValueError, wave.Error) as e:
+            print("%s: %s" % (src, e), file=sys.stderr)
+            continue
+        total_in += size_in
+        total_out += size_out
+
+    if total_in:
+        print("%d files, %d -> %d bytes" % (len(files), total_in, total_out))
+
+
+if __name__ == "__main__":
+    main()